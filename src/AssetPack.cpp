@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AssetPack.hpp"
+
+#include <exceptions.hpp>
+
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+static const char magic[4] = { 'G', 'P', 'A', 'K' };
+static const uint32_t version = 1;
+static const size_t alignment = 4096;
+
+
+AssetPack::AssetPack( const std::string & file )
+	: file( file )
+{
+	int fd = open( file.c_str(), O_RDONLY );
+	if( fd < 0 )
+		throw SYSTEM_ERROR( errno, "Could not open \"" + file + "\"" );
+	struct stat status;
+	if( fstat( fd, &status ) )
+	{
+		int error = errno;
+		close( fd );
+		throw SYSTEM_ERROR( error, "Could not stat \"" + file + "\"" );
+	}
+	this->mappingSize = status.st_size;
+	void * mapping = mmap( nullptr, this->mappingSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+	int error = errno;
+	// the mapping keeps the file alive
+	close( fd );
+	if( mapping == MAP_FAILED )
+		throw SYSTEM_ERROR( error, "Could not map \"" + file + "\"" );
+	this->mapping = (const uint8_t *)mapping;
+
+	// read ahead in the background - the pixels are needed as soon as there is a GL context
+	madvise( mapping, this->mappingSize, MADV_WILLNEED );
+
+	const Header * header = (const Header *)this->mapping;
+	if( this->mappingSize < sizeof(Header) || std::memcmp( header->magic, magic, sizeof(magic) ) || header->version != version
+	 || header->entries > ( this->mappingSize - sizeof(Header) ) / sizeof(Entry) )
+	{
+		munmap( mapping, this->mappingSize );
+		throw RUNTIME_ERROR( "\"" + file + "\" is not an asset pack of version " + std::to_string( version ) );
+	}
+	this->entries = (const Entry *)( this->mapping + sizeof(Header) );
+	this->entryCount = header->entries;
+	for( size_t i = 0; i < this->entryCount; i++ )
+	{
+		const Entry & entry = this->entries[i];
+		// written so that no sum can overflow - the sizes come from the file
+		bool valid = entry.offset <= this->mappingSize && entry.size <= this->mappingSize - entry.offset
+		          && entry.levels && entry.levels <= maxLevels && !entry.name[ sizeof(entry.name) - 1 ];
+		// the levels follow each other inside the entry, starting with the base level
+		for( unsigned int level = 0; valid && level < entry.levels; level++ )
+			valid = entry.levelOffsets[level] < entry.size && ( level ? entry.levelOffsets[level] > entry.levelOffsets[level - 1] : entry.levelOffsets[level] == 0 );
+		// and hold all of their pixels in a format that can be uploaded, so nothing reads past the mapping
+		for( unsigned int level = 0; valid && level < entry.levels; level++ )
+		{
+			size_t levelSize = Image::getLevelSize( entry.format, entry.type, entry.compressed, std::max( 1u, entry.width >> level ), std::max( 1u, entry.height >> level ) );
+			uint64_t available = ( level + 1 < entry.levels ? entry.levelOffsets[level + 1] : entry.size ) - entry.levelOffsets[level];
+			valid = entry.width && entry.height && levelSize && ( entry.compressed ? available == levelSize : available >= levelSize );
+		}
+		if( !valid )
+		{
+			munmap( mapping, this->mappingSize );
+			throw RUNTIME_ERROR( "Asset pack \"" + file + "\" is corrupt" );
+		}
+	}
+}
+
+
+AssetPack::~AssetPack()
+{
+	munmap( (void *)this->mapping, this->mappingSize );
+}
+
+
+std::unique_ptr< Image > AssetPack::getImage( const std::string & name ) const
+{
+	for( size_t i = 0; i < this->entryCount; i++ )
+	{
+		const Entry & entry = this->entries[i];
+		if( name != entry.name )
+			continue;
+		std::vector< size_t > levelOffsets( entry.levelOffsets, entry.levelOffsets + entry.levels );
+		return std::unique_ptr< Image >( new Image( name, entry.width, entry.height, entry.format, entry.type, entry.compressed,
+		                                            this->mapping + entry.offset, entry.size, levelOffsets ) );
+	}
+	return nullptr;
+}
+
+
+void AssetPack::write( const std::string & file, const std::vector< const Image * > & images )
+{
+	std::ofstream stream( file, std::ios::binary );
+	if( !stream )
+		throw RUNTIME_ERROR( "Could not open \"" + file + "\" for writing" );
+
+	Header header;
+	std::memcpy( header.magic, magic, sizeof(magic) );
+	header.version = version;
+	header.entries = images.size();
+	header.reserved = 0;
+
+	std::vector< Entry > entries( images.size() );
+	uint64_t offset = sizeof(Header) + images.size() * sizeof(Entry);
+	for( size_t i = 0; i < images.size(); i++ )
+	{
+		const Image & image = *images[i];
+		Entry & entry = entries[i];
+		std::memset( &entry, 0, sizeof(entry) );
+		if( image.getFile().size() >= sizeof(entry.name) )
+			throw RUNTIME_ERROR( "Name \"" + image.getFile() + "\" is too long for an asset pack" );
+		if( image.getLevels() > maxLevels )
+			throw RUNTIME_ERROR( "\"" + image.getFile() + "\" has too many levels for an asset pack" );
+		// the same check the loader does, so a pack that is written can be read
+		if( !Image::getLevelSize( image.getFormat(), image.getType(), image.isCompressed(), image.getWidth(), image.getHeight() ) )
+			throw RUNTIME_ERROR( "\"" + image.getFile() + "\" has a format an asset pack cannot hold" );
+		std::strcpy( entry.name, image.getFile().c_str() );
+		entry.width = image.getWidth();
+		entry.height = image.getHeight();
+		entry.format = image.getFormat();
+		entry.type = image.getType();
+		entry.compressed = image.isCompressed();
+		entry.levels = image.getLevels();
+		for( unsigned int level = 0; level < image.getLevels(); level++ )
+			entry.levelOffsets[level] = image.getData( level ) - image.getData( 0 );
+		offset = ( offset + alignment - 1 ) / alignment * alignment;
+		entry.offset = offset;
+		entry.size = image.getTotalSize();
+		offset += entry.size;
+	}
+
+	stream.write( (const char *)&header, sizeof(header) );
+	stream.write( (const char *)entries.data(), entries.size() * sizeof(Entry) );
+	for( size_t i = 0; i < images.size(); i++ )
+	{
+		// pads up to the page boundary
+		stream.seekp( entries[i].offset );
+		stream.write( (const char *)images[i]->getData( 0 ), entries[i].size );
+	}
+	if( !stream )
+		throw RUNTIME_ERROR( "Could not write \"" + file + "\"" );
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ASSETPACK_INCLUDED_
+#define _ASSETPACK_INCLUDED_
+
+
+#include "Image.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <stdint.h>
+
+
+/**
+ * A file of images that are ready for upload, mapped into memory.
+ *
+ * The pixels of every image start at a page boundary, so getImage() hands out Images that point
+ * straight into the mapping - nothing is decoded or copied before glTexImage2D. The kernel is told
+ * to start reading the whole file right away, so that overlaps with setting up the window.
+ * Images are found by the file name they were packed from, and must not outlive the pack.
+ */
+class AssetPack
+{
+public:
+	static const unsigned int maxLevels = 16;
+
+	AssetPack( const AssetPack & ) = delete;
+	AssetPack & operator=( const AssetPack & ) = delete;
+
+	AssetPack( const std::string & file );
+	virtual ~AssetPack();
+
+	// nullptr if there is no such image in the pack
+	std::unique_ptr< Image > getImage( const std::string & name ) const;
+
+	static void write( const std::string & file, const std::vector< const Image * > & images );
+
+	const std::string & getFile() const
+	{
+		return this->file;
+	}
+
+	size_t getImageCount() const
+	{
+		return this->entryCount;
+	}
+
+private:
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t entries;
+		uint32_t reserved;
+	};
+
+	struct Entry
+	{
+		char name[256];
+		uint32_t width;
+		uint32_t height;
+		uint32_t format;
+		uint32_t type;
+		uint32_t compressed;
+		uint32_t levels;
+		uint64_t offset; // from the start of the file
+		uint64_t size;
+		uint64_t levelOffsets[maxLevels]; // from offset
+	};
+
+	std::string file;
+	const uint8_t * mapping = nullptr;
+	size_t mappingSize = 0;
+	const Entry * entries = nullptr;
+	size_t entryCount = 0;
+};
+
+
+#endif
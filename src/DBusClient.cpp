@@ -23,6 +23,8 @@
 #include <stdexcept>
 #include <system_error>
 
+#include <unistd.h>
+
 
 #define SYSTEM_ERROR( errornumber, whattext ) \
 std::system_error( (errornumber), std::system_category(), std::string(__PRETTY_FUNCTION__) + std::string(": ") + (whattext) )
@@ -39,16 +41,141 @@ constexpr static const char * dBusControllerName = "PointIR.Controller";
 constexpr static const char * dBusControllerObject = "/PointIR/Controller";
 
 
-DBusClient::DBusClient()
+static DBusMessage * newMethodCall( const std::string & interface, const std::string & method )
+{
+	DBusMessage * msg = dbus_message_new_method_call(
+		dBusControllerName,    // target for the method call
+		dBusControllerObject, // object to call on
+		interface.c_str(),   // interface to call on
+		method.c_str()      // method name
+	);
+	if( !msg )
+		throw RUNTIME_ERROR( "dbus_message_new_method_call failed" );
+	return msg;
+}
+
+
+static DBusMessage * newCalibrationImageCall( const std::string & method, unsigned int width, unsigned int height )
+{
+	DBusMessage * msg = newMethodCall( "PointIR.Controller.Unprojector", method );
+
+	// append arguments
+	DBusMessageIter args;
+	dbus_message_iter_init_append( msg, &args );
+
+	DBusBasicValue value;
+	value.u32 = width;
+	if( !dbus_message_iter_append_basic( &args, DBUS_TYPE_UINT32, &value ) )
+	{
+		dbus_message_unref( msg );
+		throw RUNTIME_ERROR( "dbus_message_iter_append_basic failed" );
+	}
+	value.u32 = height;
+	if( !dbus_message_iter_append_basic( &args, DBUS_TYPE_UINT32, &value ) )
+	{
+		dbus_message_unref( msg );
+		throw RUNTIME_ERROR( "dbus_message_iter_append_basic failed" );
+	}
+	return msg;
+}
+
+
+static bool readBool( DBusMessage * reply )
+{
+	DBusMessageIter args;
+	DBusBasicValue value;
+	if( !dbus_message_iter_init( reply, &args ) )
+		throw RUNTIME_ERROR( "Expected one argument in reply" );
+	if( dbus_message_iter_get_arg_type( &args ) != DBUS_TYPE_BOOLEAN )
+		throw RUNTIME_ERROR( "Expected argument of type bool" );
+	dbus_message_iter_get_basic( &args, &value );
+	return value.bool_val;
+}
+
+
+static std::string readString( DBusMessage * reply )
+{
+	DBusMessageIter args;
+	DBusBasicValue value;
+	if( !dbus_message_iter_init( reply, &args ) )
+		throw RUNTIME_ERROR( "Expected one argument in reply" );
+	if( dbus_message_iter_get_arg_type( &args ) != DBUS_TYPE_STRING )
+		throw RUNTIME_ERROR( "Expected argument of type string" );
+	dbus_message_iter_get_basic( &args, &value );
+	return std::string( value.str );
+}
+
+
+// returns a file descriptor the caller has to close
+static int readImage( DBusMessage * reply, unsigned int & width, unsigned int & height )
+{
+	DBusMessageIter args;
+	DBusBasicValue value;
+	if( !dbus_message_iter_init( reply, &args ) )
+		throw RUNTIME_ERROR( "Expected three arguments in reply" );
+	if( dbus_message_iter_get_arg_type( &args ) != DBUS_TYPE_UNIX_FD )
+		throw RUNTIME_ERROR( "Expected argument of type unix fd" );
+	// libdbus hands out a duplicate for every call
+	dbus_message_iter_get_basic( &args, &value );
+	int fd = value.fd;
+	unsigned int * size[2] = { &width, &height };
+	for( unsigned int * s : size )
+	{
+		if( !dbus_message_iter_next( &args ) || dbus_message_iter_get_arg_type( &args ) != DBUS_TYPE_UINT32 )
+		{
+			close( fd );
+			throw RUNTIME_ERROR( "Expected the size as two arguments of type uint32" );
+		}
+		dbus_message_iter_get_basic( &args, &value );
+		*s = value.u32;
+	}
+	return fd;
+}
+
+
+typedef std::function< void( DBusMessage * reply, const std::string & error ) > ReplyCallback;
+
+
+static void pendingCallNotify( DBusPendingCall * pending, void * data )
+{
+	const ReplyCallback & callback = *(const ReplyCallback *)data;
+	DBusMessage * reply = dbus_pending_call_steal_reply( pending );
+	std::string error;
+	if( !reply )
+	{
+		error = "no reply";
+	}
+	else if( dbus_message_get_type( reply ) == DBUS_MESSAGE_TYPE_ERROR )
+	{
+		// timeouts end up here as well, as org.freedesktop.DBus.Error.NoReply
+		DBusError dBusError;
+		dbus_error_init( &dBusError );
+		dbus_set_error_from_message( &dBusError, reply );
+		error = std::string( dBusError.name ) + ": " + ( dBusError.message ? dBusError.message : "" );
+		dbus_error_free( &dBusError );
+	}
+	callback( error.empty() ? reply : nullptr, error );
+	if( reply )
+		dbus_message_unref( reply );
+}
+
+
+static void pendingCallFree( void * data )
+{
+	delete (ReplyCallback *)data;
+}
+
+
+DBusClient::DBusClient( DBusBusType busType )
 {
 	dbus_error_init( &this->dBusError );
 	try
 	{
-		this->dBusConnection = dbus_bus_get( DBUS_BUS_SYSTEM, &(this->dBusError) );
+		this->dBusConnection = dbus_bus_get( busType, &(this->dBusError) );
 		if( dbus_error_is_set( &this->dBusError ) )
 			throw RUNTIME_ERROR( "Connection Error: " + std::string(this->dBusError.message) );
 		if( !this->dBusConnection )
-			throw RUNTIME_ERROR( "Could not connect to system DBus" );
+			throw RUNTIME_ERROR( "Could not connect to DBus" );
 
 		int ret = dbus_bus_request_name(
 			this->dBusConnection,
@@ -59,7 +186,7 @@ DBusClient::DBusClient()
 		if( dbus_error_is_set( &this->dBusError ) )
 			throw RUNTIME_ERROR( "Name Error: " + std::string(this->dBusError.message) );
 		if( DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER != ret )
-			throw RUNTIME_ERROR( "Could not request name on system DBus" );
+			throw RUNTIME_ERROR( "Could not request name on DBus" );
 	} catch( ... )
 	{
 		// uninitialise dbus and rethrow exception
@@ -81,35 +208,25 @@ DBusClient::~DBusClient()
 
 bool DBusClient::getBool( const std::string & interface, const std::string & method ) const
 {
-	DBusMessage * msg = dbus_message_new_method_call(
-		dBusControllerName,    // target for the method call
-		dBusControllerObject, // object to call on
-		interface.c_str(),   // interface to call on
-		method.c_str()      // method name
-	);
-	if( !msg )
-		throw RUNTIME_ERROR( "dbus_message_new_method_call failed" );
-
-	// append arguments
-	DBusMessageIter args;
-	dbus_message_iter_init_append( msg, &args );
+	DBusMessage * msg = newMethodCall( interface, method );
 
 	// send message and get a handle for a reply
 	DBusMessage * reply = dbus_connection_send_with_reply_and_block( this->dBusConnection, msg, -1, &this->dBusError ); // -1 is default timeout
+	dbus_message_unref( msg );
 	if( !reply )
 		throw RUNTIME_ERROR( "dbus_connection_send_with_reply_and_block failed: " + std::string(this->dBusError.message) );
 
 	// handle arguments in reply
-	DBusBasicValue value;
-	if( !dbus_message_iter_init( reply, &args ) )
-		throw RUNTIME_ERROR( "Expected one argument in reply" );
-	if( dbus_message_iter_get_arg_type( &args ) != DBUS_TYPE_BOOLEAN )
-		throw RUNTIME_ERROR( "Expected argument of type bool" );
-	dbus_message_iter_get_basic( &args, &value );
-	bool result = value.bool_val;
-
-	// free messages
-	dbus_message_unref( msg );
+	bool result;
+	try
+	{
+		result = readBool( reply );
+	}
+	catch( ... )
+	{
+		dbus_message_unref( reply );
+		throw;
+	}
 	dbus_message_unref( reply );
 
 	return result;
@@ -118,42 +235,25 @@ bool DBusClient::getBool( const std::string & interface, const std::string & met
 
 std::string DBusClient::getCalibrationImageFile( unsigned int width, unsigned int height ) const
 {
-	DBusMessage * msg = dbus_message_new_method_call(
-		dBusControllerName,               // target for the method call
-		dBusControllerObject,             // object to call on
-		"PointIR.Controller.Unprojector", // interface to call on
-		"generateCalibrationImageFile"    // method name
-	);
-	if( !msg )
-		throw RUNTIME_ERROR( "dbus_message_new_method_call failed" );
-
-	// append arguments
-	DBusMessageIter args;
-	dbus_message_iter_init_append( msg, &args );
-
-	DBusBasicValue value;
-	value.u32 = width;
-	if( !dbus_message_iter_append_basic( &args, DBUS_TYPE_UINT32, &value ) )
-		throw RUNTIME_ERROR( "dbus_message_iter_append_basic failed" );
-	value.u32 = height;
-	if( !dbus_message_iter_append_basic( &args, DBUS_TYPE_UINT32, &value ) )
-		throw RUNTIME_ERROR( "dbus_message_iter_append_basic failed" );
+	DBusMessage * msg = newCalibrationImageCall( "generateCalibrationImageFile", width, height );
 
 	// send message and get a handle for a reply
 	DBusMessage * reply = dbus_connection_send_with_reply_and_block( this->dBusConnection, msg, -1, &this->dBusError ); // -1 is default timeout
+	dbus_message_unref( msg );
 	if( !reply )
 		throw RUNTIME_ERROR( "dbus_connection_send_with_reply_and_block failed: " + std::string(this->dBusError.message) );
 
 	// handle arguments in reply
-	if( !dbus_message_iter_init( reply, &args ) )
-		throw RUNTIME_ERROR( "Expected one argument in reply" );
-	if( dbus_message_iter_get_arg_type( &args ) != DBUS_TYPE_STRING )
-		throw RUNTIME_ERROR( "Expected argument of type string" );
-	dbus_message_iter_get_basic( &args, &value );
-	std::string filename( value.str );
-
-	// free messages
-	dbus_message_unref( msg );
+	std::string filename;
+	try
+	{
+		filename = readString( reply );
+	}
+	catch( ... )
+	{
+		dbus_message_unref( reply );
+		throw;
+	}
 	dbus_message_unref( reply );
 
 	return filename;
@@ -170,3 +270,110 @@ bool DBusClient::saveCalibrationData() const
 {
 	return this->getBool( "PointIR.Controller.Unprojector", "saveCalibrationData" );
 }
+
+
+void DBusClient::sendAsync( DBusMessage * msg, const ReplyCallback & callback, int timeout ) const
+{
+	DBusPendingCall * pending = nullptr;
+	bool sent = dbus_connection_send_with_reply( this->dBusConnection, msg, &pending, timeout );
+	dbus_message_unref( msg );
+	// pending stays null if the connection is closed
+	if( !sent || !pending )
+		throw RUNTIME_ERROR( "dbus_connection_send_with_reply failed" );
+
+	ReplyCallback * data = new ReplyCallback( callback );
+	if( !dbus_pending_call_set_notify( pending, pendingCallNotify, data, pendingCallFree ) )
+	{
+		delete data;
+		dbus_pending_call_cancel( pending );
+		dbus_pending_call_unref( pending );
+		throw RUNTIME_ERROR( "dbus_pending_call_set_notify failed" );
+	}
+	// the connection keeps the call until it completes
+	dbus_pending_call_unref( pending );
+}
+
+
+void DBusClient::getBoolAsync( const std::string & interface, const std::string & method, const BoolCallback & callback, int timeout ) const
+{
+	this->sendAsync( newMethodCall( interface, method ), [callback]( DBusMessage * reply, const std::string & error )
+	{
+		bool result = false;
+		std::string readError = error;
+		if( reply )
+		{
+			try
+			{
+				result = readBool( reply );
+			}
+			catch( const std::exception & e )
+			{
+				readError = e.what();
+			}
+		}
+		callback( result, readError );
+	}, timeout );
+}
+
+
+void DBusClient::getCalibrationImageFileAsync( unsigned int width, unsigned int height, const StringCallback & callback, int timeout ) const
+{
+	this->sendAsync( newCalibrationImageCall( "generateCalibrationImageFile", width, height ), [callback]( DBusMessage * reply, const std::string & error )
+	{
+		std::string result;
+		std::string readError = error;
+		if( reply )
+		{
+			try
+			{
+				result = readString( reply );
+			}
+			catch( const std::exception & e )
+			{
+				readError = e.what();
+			}
+		}
+		callback( result, readError );
+	}, timeout );
+}
+
+
+void DBusClient::calibrateAsync( const BoolCallback & callback, int timeout ) const
+{
+	this->getBoolAsync( "PointIR.Controller.Processor", "calibrate", callback, timeout );
+}
+
+
+void DBusClient::saveCalibrationDataAsync( const BoolCallback & callback, int timeout ) const
+{
+	this->getBoolAsync( "PointIR.Controller.Unprojector", "saveCalibrationData", callback, timeout );
+}
+
+
+void DBusClient::getCalibrationImageAsync( unsigned int width, unsigned int height, const ImageCallback & callback, int timeout ) const
+{
+	this->sendAsync( newCalibrationImageCall( "generateCalibrationImage", width, height ), [callback]( DBusMessage * reply, const std::string & error )
+	{
+		int fd = -1;
+		unsigned int width = 0, height = 0;
+		std::string readError = error;
+		if( reply )
+		{
+			try
+			{
+				fd = readImage( reply, width, height );
+			}
+			catch( const std::exception & e )
+			{
+				readError = e.what();
+			}
+		}
+		callback( fd, width, height, readError );
+	}, timeout );
+}
+
+
+bool DBusClient::canPassFileDescriptors() const
+{
+	return dbus_connection_can_send_type( this->dBusConnection, DBUS_TYPE_UNIX_FD );
+}
@@ -24,6 +24,7 @@
 #include <dbus/dbus.h>
 
 #include <string>
+#include <functional>
 
 
 namespace PointIR
@@ -31,13 +32,36 @@ namespace PointIR
 	class DBusClient
 	{
 	public:
-		DBusClient();
+		// the error is empty on success
+		typedef std::function< void( bool result, const std::string & error ) > BoolCallback;
+		typedef std::function< void( const std::string & result, const std::string & error ) > StringCallback;
+		// fd is -1 on error, otherwise the callback owns it
+		typedef std::function< void( int fd, unsigned int width, unsigned int height, const std::string & error ) > ImageCallback;
+
+		DBusClient( DBusBusType busType = DBUS_BUS_SYSTEM );
 		virtual ~DBusClient();
 		bool getBool( const std::string & interface, const std::string & method ) const;
 		std::string getCalibrationImageFile( unsigned int width, unsigned int height ) const;
 		bool calibrate() const;
 		bool saveCalibrationData() const;
+
+		// send the call and return at once - the callback runs from dbus_connection_dispatch() once the reply
+		// arrived or the call timed out (timeout in milliseconds, -1 is the default timeout). Callbacks must not throw,
+		// and the main loop has to serve the timeout functions of the connection for timeouts to fire.
+		void getBoolAsync( const std::string & interface, const std::string & method, const BoolCallback & callback, int timeout = -1 ) const;
+		void getCalibrationImageFileAsync( unsigned int width, unsigned int height, const StringCallback & callback, int timeout = -1 ) const;
+		void calibrateAsync( const BoolCallback & callback, int timeout = -1 ) const;
+		void saveCalibrationDataAsync( const BoolCallback & callback, int timeout = -1 ) const;
+		// the image comes as a memfd or shm file descriptor holding width*height RGBA8 pixels, bottom row first,
+		// so it can be mapped and uploaded without touching the disk or a decoder
+		void getCalibrationImageAsync( unsigned int width, unsigned int height, const ImageCallback & callback, int timeout = -1 ) const;
+		bool canPassFileDescriptors() const;
+
+		// for integrating the connection into a main loop
+		DBusConnection * getConnection() const { return this->dBusConnection; }
 	private:
+		void sendAsync( DBusMessage * msg, const std::function< void( DBusMessage * reply, const std::string & error ) > & callback, int timeout ) const;
+
 		mutable DBusError dBusError;
 		DBusConnection * dBusConnection = nullptr;
 	};
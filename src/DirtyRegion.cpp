@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DirtyRegion.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+
+DirtyRegion::DirtyRegion( unsigned int width, unsigned int height, unsigned int settleSteps )
+	: width( width ), height( height ), settleSteps( settleSteps )
+{
+}
+
+
+DirtyRegion::~DirtyRegion()
+{
+}
+
+
+unsigned int DirtyRegion::getSettleSteps( double damping, double quantum )
+{
+	// height and velocity form a damped oscillator whose two eigenvalues multiply to damping,
+	// so the amplitude shrinks by sqrt( damping ) per step
+	return (unsigned int)std::ceil( std::log( 0.5 / quantum ) / ( -0.5 * std::log( damping ) ) );
+}
+
+
+void DirtyRegion::disturb( const float position[2], float radius )
+{
+	// one pixel margin for the rasterization of the disturbance
+	int xMin = std::max( 0, (int)std::floor( ( position[0] - radius + 1.0f ) * 0.5f * this->width ) - 1 );
+	int xMax = std::min( (int)this->width, (int)std::ceil( ( position[0] + radius + 1.0f ) * 0.5f * this->width ) + 1 );
+	int yMin = std::max( 0, (int)std::floor( ( position[1] - radius + 1.0f ) * 0.5f * this->height ) - 1 );
+	int yMax = std::min( (int)this->height, (int)std::ceil( ( position[1] + radius + 1.0f ) * 0.5f * this->height ) + 1 );
+	if( xMin >= xMax || yMin >= yMax )
+		return;
+
+	if( this->isEmpty() )
+	{
+		this->x0 = xMin;
+		this->y0 = yMin;
+		this->x1 = xMax;
+		this->y1 = yMax;
+	}
+	else
+	{
+		this->x0 = std::min( this->x0, xMin );
+		this->y0 = std::min( this->y0, yMin );
+		this->x1 = std::max( this->x1, xMax );
+		this->y1 = std::max( this->y1, yMax );
+	}
+	this->calmSteps = 0;
+}
+
+
+bool DirtyRegion::step()
+{
+	if( this->isEmpty() )
+		return false;
+	if( ++this->calmSteps > this->settleSteps )
+	{
+		this->clear();
+		return false;
+	}
+	this->x0 = std::max( 0, this->x0 - 1 );
+	this->y0 = std::max( 0, this->y0 - 1 );
+	this->x1 = std::min( (int)this->width, this->x1 + 1 );
+	this->y1 = std::min( (int)this->height, this->y1 + 1 );
+	return true;
+}
+
+
+void DirtyRegion::clear()
+{
+	this->x0 = this->y0 = this->x1 = this->y1 = 0;
+	this->calmSteps = 0;
+}
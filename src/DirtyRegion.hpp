@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DIRTYREGION_INCLUDED_
+#define _DIRTYREGION_INCLUDED_
+
+
+/**
+ * Bounding box of the water pixels that may not be calm.
+ *
+ * Disturbances add their bounding box in normalized device coordinates. Every simulation step
+ * grows the box by one pixel, because that is as far as a wave travels per step. Once no
+ * disturbance happened for settleSteps steps, the remaining waves are assumed to have died
+ * out: step() empties the box and returns false, and the caller resets the water to calm.
+ * Outside the box the water is calm in both buffers, so steps may be restricted to the box.
+ */
+class DirtyRegion
+{
+public:
+	DirtyRegion( const DirtyRegion & ) = delete;
+	DirtyRegion & operator=( const DirtyRegion & ) = delete;
+
+	DirtyRegion( unsigned int width, unsigned int height, unsigned int settleSteps );
+	virtual ~DirtyRegion();
+
+	// steps until a wave of amplitude 0.5 becomes smaller than quantum, with the velocity damped by damping per step
+	static unsigned int getSettleSteps( double damping, double quantum );
+
+	void disturb( const float position[2], float radius );
+	bool step();
+	void clear();
+
+	bool isEmpty() const
+	{
+		return this->x0 >= this->x1 || this->y0 >= this->y1;
+	}
+
+	unsigned int getX() const
+	{
+		return this->x0;
+	}
+
+	unsigned int getY() const
+	{
+		return this->y0;
+	}
+
+	unsigned int getWidth() const
+	{
+		return this->isEmpty() ? 0 : this->x1 - this->x0;
+	}
+
+	unsigned int getHeight() const
+	{
+		return this->isEmpty() ? 0 : this->y1 - this->y0;
+	}
+
+	unsigned int getSettleSteps() const
+	{
+		return this->settleSteps;
+	}
+
+private:
+	unsigned int width;
+	unsigned int height;
+	unsigned int settleSteps;
+	unsigned int calmSteps = 0; // steps since the last disturbance
+	int x0 = 0;
+	int y0 = 0;
+	int x1 = 0;
+	int y1 = 0;
+};
+
+
+#endif
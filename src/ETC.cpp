@@ -0,0 +1,537 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ETC.hpp"
+
+#include <exceptions.hpp>
+
+#include <algorithm>
+#include <limits>
+
+
+////////////////////////////////////////////////////////////////
+// Tables of the specification
+
+static const int modifierTable[8][4] =
+{
+	{  2,   8,  -2,   -8 },
+	{  5,  17,  -5,  -17 },
+	{  9,  29,  -9,  -29 },
+	{ 13,  42, -13,  -42 },
+	{ 18,  60, -18,  -60 },
+	{ 24,  80, -24,  -80 },
+	{ 33, 106, -33, -106 },
+	{ 47, 183, -47, -183 }
+};
+
+static const int distanceTable[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+static const int alphaModifierTable[16][8] =
+{
+	{ -3, -6,  -9, -15, 2, 5, 8, 14 },
+	{ -3, -7, -10, -13, 2, 6, 9, 12 },
+	{ -2, -5,  -8, -13, 1, 4, 7, 12 },
+	{ -2, -4,  -6, -13, 1, 3, 5, 12 },
+	{ -3, -6,  -8, -12, 2, 5, 7, 11 },
+	{ -3, -7,  -9, -11, 2, 6, 8, 10 },
+	{ -4, -7,  -8, -11, 3, 6, 7, 10 },
+	{ -3, -5,  -8, -11, 2, 4, 7, 10 },
+	{ -2, -6,  -8, -10, 1, 5, 7,  9 },
+	{ -2, -5,  -8, -10, 1, 4, 7,  9 },
+	{ -2, -4,  -8, -10, 1, 3, 7,  9 },
+	{ -2, -5,  -7, -10, 1, 4, 6,  9 },
+	{ -3, -4,  -7, -10, 2, 3, 6,  9 },
+	{ -1, -2,  -3, -10, 0, 1, 2,  9 },
+	{ -4, -6,  -8,  -9, 3, 5, 7,  8 },
+	{ -3, -5,  -7,  -9, 2, 4, 6,  8 }
+};
+
+
+static inline int clamp255( int value )
+{
+	return std::min( 255, std::max( 0, value ) );
+}
+
+
+static inline int extend4( int value )
+{
+	return ( value << 4 ) | value;
+}
+
+
+static inline int extend5( int value )
+{
+	return ( value << 3 ) | ( value >> 2 );
+}
+
+
+static inline int extend6( int value )
+{
+	return ( value << 2 ) | ( value >> 4 );
+}
+
+
+static inline int extend7( int value )
+{
+	return ( value << 1 ) | ( value >> 6 );
+}
+
+
+// blocks are big endian
+static inline uint64_t readBlock( const uint8_t * block )
+{
+	uint64_t result = 0;
+	for( unsigned int i = 0; i < 8; i++ )
+		result = ( result << 8 ) | block[i];
+	return result;
+}
+
+
+static inline void writeBlock( uint64_t value, uint8_t * block )
+{
+	for( unsigned int i = 0; i < 8; i++ )
+		block[i] = value >> ( 56 - 8*i );
+}
+
+
+static inline unsigned int bits( uint64_t block, unsigned int highest, unsigned int count )
+{
+	return ( block >> ( highest + 1 - count ) ) & ( ( 1u << count ) - 1 );
+}
+
+
+////////////////////////////////////////////////////////////////
+// Decoding
+
+// writes the 4x4 texels of the block as RGBA, alpha is left alone
+static void decodeColorBlock( uint64_t block, uint8_t texels[16][4] )
+{
+	// pixels are numbered column by column
+	auto index = [&]( unsigned int pixel )
+	{
+		return ( bits( block, pixel + 16, 1 ) << 1 ) | bits( block, pixel, 1 );
+	};
+	auto set = [&]( unsigned int pixel, int r, int g, int b )
+	{
+		unsigned int x = pixel / 4, y = pixel % 4;
+		texels[4*y+x][0] = clamp255( r );
+		texels[4*y+x][1] = clamp255( g );
+		texels[4*y+x][2] = clamp255( b );
+	};
+
+	int base[2][3];
+	bool flip = bits( block, 32, 1 );
+	if( !bits( block, 33, 1 ) )
+	{
+		// individual
+		for( unsigned int c = 0; c < 3; c++ )
+		{
+			base[0][c] = extend4( bits( block, 63 - 8*c, 4 ) );
+			base[1][c] = extend4( bits( block, 59 - 8*c, 4 ) );
+		}
+	}
+	else
+	{
+		int first[3], second[3];
+		for( unsigned int c = 0; c < 3; c++ )
+		{
+			first[c] = bits( block, 63 - 8*c, 5 );
+			int delta = bits( block, 58 - 8*c, 3 );
+			second[c] = first[c] + ( delta >= 4 ? delta - 8 : delta );
+		}
+
+		if( second[0] < 0 || second[0] > 31 )
+		{
+			// T mode
+			int paint[4][3];
+			int c1[3] = { extend4( ( bits( block, 60, 2 ) << 2 ) | bits( block, 57, 2 ) ), extend4( bits( block, 55, 4 ) ), extend4( bits( block, 51, 4 ) ) };
+			int c2[3] = { extend4( bits( block, 47, 4 ) ), extend4( bits( block, 43, 4 ) ), extend4( bits( block, 39, 4 ) ) };
+			int distance = distanceTable[ ( bits( block, 35, 2 ) << 1 ) | bits( block, 32, 1 ) ];
+			for( unsigned int c = 0; c < 3; c++ )
+			{
+				paint[0][c] = c1[c];
+				paint[1][c] = c2[c] + distance;
+				paint[2][c] = c2[c];
+				paint[3][c] = c2[c] - distance;
+			}
+			for( unsigned int pixel = 0; pixel < 16; pixel++ )
+			{
+				const int * p = paint[ index( pixel ) ];
+				set( pixel, p[0], p[1], p[2] );
+			}
+			return;
+		}
+		if( second[1] < 0 || second[1] > 31 )
+		{
+			// H mode
+			int paint[4][3];
+			int r1 = bits( block, 62, 4 );
+			int g1 = ( bits( block, 58, 3 ) << 1 ) | bits( block, 52, 1 );
+			int b1 = ( bits( block, 51, 1 ) << 3 ) | bits( block, 49, 3 );
+			int r2 = bits( block, 46, 4 );
+			int g2 = bits( block, 42, 4 );
+			int b2 = bits( block, 38, 4 );
+			int c1[3] = { extend4( r1 ), extend4( g1 ), extend4( b1 ) };
+			int c2[3] = { extend4( r2 ), extend4( g2 ), extend4( b2 ) };
+			unsigned int order = ( ( r1 << 8 ) | ( g1 << 4 ) | b1 ) >= ( ( r2 << 8 ) | ( g2 << 4 ) | b2 );
+			int distance = distanceTable[ ( bits( block, 34, 1 ) << 2 ) | ( bits( block, 32, 1 ) << 1 ) | order ];
+			for( unsigned int c = 0; c < 3; c++ )
+			{
+				paint[0][c] = c1[c] + distance;
+				paint[1][c] = c1[c] - distance;
+				paint[2][c] = c2[c] + distance;
+				paint[3][c] = c2[c] - distance;
+			}
+			for( unsigned int pixel = 0; pixel < 16; pixel++ )
+			{
+				const int * p = paint[ index( pixel ) ];
+				set( pixel, p[0], p[1], p[2] );
+			}
+			return;
+		}
+		if( second[2] < 0 || second[2] > 31 )
+		{
+			// planar - origin, horizontal and vertical color
+			int o[3] = {
+				extend6( bits( block, 62, 6 ) ),
+				extend7( ( bits( block, 56, 1 ) << 6 ) | bits( block, 54, 6 ) ),
+				extend6( ( bits( block, 48, 1 ) << 5 ) | ( bits( block, 44, 2 ) << 3 ) | bits( block, 41, 3 ) ) };
+			int h[3] = {
+				extend6( ( bits( block, 38, 5 ) << 1 ) | bits( block, 32, 1 ) ),
+				extend7( bits( block, 31, 7 ) ),
+				extend6( bits( block, 24, 6 ) ) };
+			int v[3] = {
+				extend6( bits( block, 18, 6 ) ),
+				extend7( bits( block, 12, 7 ) ),
+				extend6( bits( block, 5, 6 ) ) };
+			for( unsigned int pixel = 0; pixel < 16; pixel++ )
+			{
+				int x = pixel / 4, y = pixel % 4;
+				int color[3];
+				for( unsigned int c = 0; c < 3; c++ )
+					color[c] = ( x * ( h[c] - o[c] ) + y * ( v[c] - o[c] ) + 4 * o[c] + 2 ) >> 2;
+				set( pixel, color[0], color[1], color[2] );
+			}
+			return;
+		}
+
+		// differential
+		for( unsigned int c = 0; c < 3; c++ )
+		{
+			base[0][c] = extend5( first[c] );
+			base[1][c] = extend5( second[c] );
+		}
+	}
+
+	unsigned int table[2] = { bits( block, 39, 3 ), bits( block, 36, 3 ) };
+	for( unsigned int pixel = 0; pixel < 16; pixel++ )
+	{
+		unsigned int x = pixel / 4, y = pixel % 4;
+		unsigned int subblock = flip ? y >= 2 : x >= 2;
+		int modifier = modifierTable[ table[subblock] ][ index( pixel ) ];
+		const int * b = base[subblock];
+		set( pixel, b[0] + modifier, b[1] + modifier, b[2] + modifier );
+	}
+}
+
+
+static void decodeAlphaBlock( uint64_t block, uint8_t texels[16][4] )
+{
+	int base = bits( block, 63, 8 );
+	int multiplier = bits( block, 55, 4 );
+	const int * modifiers = alphaModifierTable[ bits( block, 51, 4 ) ];
+	for( unsigned int pixel = 0; pixel < 16; pixel++ )
+	{
+		unsigned int x = pixel / 4, y = pixel % 4;
+		texels[4*y+x][3] = clamp255( base + modifiers[ bits( block, 47 - 3*pixel, 3 ) ] * multiplier );
+	}
+}
+
+
+////////////////////////////////////////////////////////////////
+// Encoding
+
+static inline int square( int value )
+{
+	return value * value;
+}
+
+
+// error and indices of the best modifier of a table for each pixel of a subblock
+static int fitSubblock( const int base[3], unsigned int table, const uint8_t texels[16][4], const unsigned int pixels[8], unsigned int indices[8] )
+{
+	int error = 0;
+	for( unsigned int i = 0; i < 8; i++ )
+	{
+		const uint8_t * texel = texels[ pixels[i] ];
+		int best = std::numeric_limits< int >::max();
+		for( unsigned int j = 0; j < 4; j++ )
+		{
+			int modifier = modifierTable[table][j];
+			int e = square( clamp255( base[0] + modifier ) - texel[0] ) + square( clamp255( base[1] + modifier ) - texel[1] ) + square( clamp255( base[2] + modifier ) - texel[2] );
+			if( e < best )
+			{
+				best = e;
+				indices[i] = j;
+			}
+		}
+		error += best;
+	}
+	return error;
+}
+
+
+static uint64_t encodeColorBlock( const uint8_t texels[16][4] )
+{
+	uint64_t bestBlock = 0;
+	int bestError = std::numeric_limits< int >::max();
+
+	for( unsigned int flip = 0; flip < 2; flip++ )
+	{
+		// the pixels of both subblocks, numbered column by column like the index bits
+		unsigned int pixels[2][8];
+		unsigned int count[2] = { 0, 0 };
+		int sum[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+		for( unsigned int pixel = 0; pixel < 16; pixel++ )
+		{
+			unsigned int x = pixel / 4, y = pixel % 4;
+			unsigned int subblock = flip ? y >= 2 : x >= 2;
+			pixels[subblock][ count[subblock]++ ] = 4*y + x;
+			for( unsigned int c = 0; c < 3; c++ )
+				sum[subblock][c] += texels[4*y+x][c];
+		}
+
+		for( unsigned int differential = 0; differential < 2; differential++ )
+		{
+			int quantized[2][3];
+			int base[2][3];
+			bool valid = true;
+			for( unsigned int s = 0; s < 2; s++ )
+			{
+				for( unsigned int c = 0; c < 3; c++ )
+				{
+					int maximum = differential ? 31 : 15;
+					quantized[s][c] = ( sum[s][c] * maximum + 8 * 255 / 2 ) / ( 8 * 255 );
+					base[s][c] = differential ? extend5( quantized[s][c] ) : extend4( quantized[s][c] );
+				}
+			}
+			if( differential )
+			{
+				for( unsigned int c = 0; c < 3; c++ )
+					valid = valid && quantized[1][c] - quantized[0][c] >= -4 && quantized[1][c] - quantized[0][c] <= 3;
+			}
+			if( !valid )
+				continue;
+
+			unsigned int tables[2];
+			unsigned int indices[2][8];
+			int error = 0;
+			for( unsigned int s = 0; s < 2; s++ )
+			{
+				int best = std::numeric_limits< int >::max();
+				for( unsigned int table = 0; table < 8; table++ )
+				{
+					unsigned int candidate[8];
+					int e = fitSubblock( base[s], table, texels, pixels[s], candidate );
+					if( e < best )
+					{
+						best = e;
+						tables[s] = table;
+						std::copy( candidate, candidate + 8, indices[s] );
+					}
+				}
+				error += best;
+			}
+			if( error >= bestError )
+				continue;
+			bestError = error;
+
+			uint64_t block = 0;
+			for( unsigned int c = 0; c < 3; c++ )
+			{
+				if( differential )
+				{
+					block |= (uint64_t)quantized[0][c] << ( 59 - 8*c );
+					block |= (uint64_t)( ( quantized[1][c] - quantized[0][c] ) & 7 ) << ( 56 - 8*c );
+				}
+				else
+				{
+					block |= (uint64_t)quantized[0][c] << ( 60 - 8*c );
+					block |= (uint64_t)quantized[1][c] << ( 56 - 8*c );
+				}
+			}
+			block |= (uint64_t)tables[0] << 37;
+			block |= (uint64_t)tables[1] << 34;
+			block |= (uint64_t)differential << 33;
+			block |= (uint64_t)flip << 32;
+			for( unsigned int s = 0; s < 2; s++ )
+			{
+				for( unsigned int i = 0; i < 8; i++ )
+				{
+					unsigned int texel = pixels[s][i];
+					unsigned int pixel = ( texel % 4 ) * 4 + texel / 4;
+					block |= (uint64_t)( indices[s][i] >> 1 ) << ( pixel + 16 );
+					block |= (uint64_t)( indices[s][i] & 1 ) << pixel;
+				}
+			}
+			bestBlock = block;
+		}
+	}
+	return bestBlock;
+}
+
+
+static uint64_t encodeAlphaBlock( const uint8_t texels[16][4] )
+{
+	int minimum = 255, maximum = 0;
+	for( unsigned int i = 0; i < 16; i++ )
+	{
+		minimum = std::min( minimum, (int)texels[i][3] );
+		maximum = std::max( maximum, (int)texels[i][3] );
+	}
+
+	uint64_t bestBlock = 0;
+	int bestError = std::numeric_limits< int >::max();
+	for( unsigned int table = 0; table < 16 && bestError; table++ )
+	{
+		const int * modifiers = alphaModifierTable[table];
+		int span = modifiers[7] - modifiers[3];
+		int guess = std::max( 1, std::min( 15, ( maximum - minimum + span / 2 ) / span ) );
+		for( int multiplier = std::max( 1, guess - 1 ); multiplier <= std::min( 15, guess + 1 ); multiplier++ )
+		{
+			// centers the modifiers of the table on the range of the block
+			int base = clamp255( ( minimum + maximum - ( modifiers[7] + modifiers[3] ) * multiplier + 1 ) / 2 );
+			uint64_t block = (uint64_t)base << 56 | (uint64_t)multiplier << 52 | (uint64_t)table << 48;
+			int error = 0;
+			for( unsigned int pixel = 0; pixel < 16; pixel++ )
+			{
+				unsigned int x = pixel / 4, y = pixel % 4;
+				int alpha = texels[4*y+x][3];
+				int best = std::numeric_limits< int >::max();
+				unsigned int bestIndex = 0;
+				for( unsigned int i = 0; i < 8; i++ )
+				{
+					int e = square( clamp255( base + modifiers[i] * multiplier ) - alpha );
+					if( e < best )
+					{
+						best = e;
+						bestIndex = i;
+					}
+				}
+				error += best;
+				block |= (uint64_t)bestIndex << ( 45 - 3*pixel );
+			}
+			if( error < bestError )
+			{
+				bestError = error;
+				bestBlock = block;
+			}
+		}
+	}
+	return bestBlock;
+}
+
+
+////////////////////////////////////////////////////////////////
+// ETC
+
+bool ETC::isFormat( GLenum format )
+{
+	return format == GL_ETC1_RGB8_OES || format == GL_COMPRESSED_RGB8_ETC2 || format == GL_COMPRESSED_RGBA8_ETC2_EAC;
+}
+
+
+bool ETC::hasAlpha( GLenum format )
+{
+	return format == GL_COMPRESSED_RGBA8_ETC2_EAC;
+}
+
+
+unsigned int ETC::getBlockBytes( GLenum format )
+{
+	return hasAlpha( format ) ? 16 : 8;
+}
+
+
+size_t ETC::getSize( GLenum format, unsigned int width, unsigned int height )
+{
+	return (size_t)( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 ) * getBlockBytes( format );
+}
+
+
+void ETC::decode( GLenum format, const uint8_t * blocks, unsigned int width, unsigned int height, uint8_t * rgba )
+{
+	if( !isFormat( format ) )
+		throw RUNTIME_ERROR( "Not an ETC format" );
+
+	bool alpha = hasAlpha( format );
+	for( unsigned int by = 0; by < height; by += 4 )
+	{
+		for( unsigned int bx = 0; bx < width; bx += 4 )
+		{
+			uint8_t texels[16][4];
+			if( alpha )
+			{
+				decodeAlphaBlock( readBlock( blocks ), texels );
+				blocks += 8;
+			}
+			else
+			{
+				for( unsigned int i = 0; i < 16; i++ )
+					texels[i][3] = 255;
+			}
+			decodeColorBlock( readBlock( blocks ), texels );
+			blocks += 8;
+
+			// blocks at the right and top edge may be partially outside
+			for( unsigned int y = 0; y < 4 && by + y < height; y++ )
+				for( unsigned int x = 0; x < 4 && bx + x < width; x++ )
+					std::copy( texels[4*y+x], texels[4*y+x] + 4, rgba + 4*( width*( by + y ) + bx + x ) );
+		}
+	}
+}
+
+
+void ETC::encode( const uint8_t * rgba, unsigned int width, unsigned int height, bool alpha, uint8_t * blocks )
+{
+	for( unsigned int by = 0; by < height; by += 4 )
+	{
+		for( unsigned int bx = 0; bx < width; bx += 4 )
+		{
+			// partial blocks repeat the edge texels
+			uint8_t texels[16][4];
+			for( unsigned int y = 0; y < 4; y++ )
+			{
+				for( unsigned int x = 0; x < 4; x++ )
+				{
+					const uint8_t * texel = rgba + 4*( width*std::min( by + y, height - 1 ) + std::min( bx + x, width - 1 ) );
+					std::copy( texel, texel + 4, texels[4*y+x] );
+				}
+			}
+
+			if( alpha )
+			{
+				writeBlock( encodeAlphaBlock( texels ), blocks );
+				blocks += 8;
+			}
+			writeBlock( encodeColorBlock( texels ), blocks );
+			blocks += 8;
+		}
+	}
+}
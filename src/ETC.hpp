@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ETC_INCLUDED_
+#define _ETC_INCLUDED_
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+// core in GLES3 only - GLES2 drivers may still know them
+#ifndef GL_ETC1_RGB8_OES
+	#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+	#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+	#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+
+
+/**
+ * Ericsson texture compression: ETC1 and ETC2 RGB8 blocks, optionally preceded by an EAC alpha block.
+ *
+ * decode() is the fallback for drivers that cannot sample a format, so it handles every mode
+ * of the blocks. encode() is for preparing assets offline - it only writes ETC1 individual and
+ * differential blocks (which are valid ETC2 as well) and searches them exhaustively but naively.
+ * Images are RGBA8 and tightly packed, with rows in the same order as the blocks.
+ */
+class ETC
+{
+public:
+	ETC() = delete;
+
+	static bool isFormat( GLenum format );
+	static bool hasAlpha( GLenum format );
+	static unsigned int getBlockBytes( GLenum format );
+	static size_t getSize( GLenum format, unsigned int width, unsigned int height );
+
+	static void decode( GLenum format, const uint8_t * blocks, unsigned int width, unsigned int height, uint8_t * rgba );
+	// writes GL_ETC1_RGB8_OES or, with alpha, GL_COMPRESSED_RGBA8_ETC2_EAC blocks
+	static void encode( const uint8_t * rgba, unsigned int width, unsigned int height, bool alpha, uint8_t * blocks );
+};
+
+
+#endif
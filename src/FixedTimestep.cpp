@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FixedTimestep.hpp"
+
+#include <exceptions.hpp>
+
+#include <cmath>
+
+
+FixedTimestep::FixedTimestep( double rate, unsigned int maxSteps )
+{
+	if( rate <= 0.0 )
+		throw RUNTIME_ERROR( "Simulation rate must be positive" );
+	this->stepSeconds = 1.0 / rate;
+	this->maxSteps = maxSteps ? maxSteps : 1;
+}
+
+
+FixedTimestep::~FixedTimestep()
+{
+}
+
+
+unsigned int FixedTimestep::advance( double seconds )
+{
+	this->accumulator += seconds;
+	double due = std::floor( this->accumulator / this->stepSeconds );
+	if( due > this->maxSteps )
+	{
+		this->droppedSteps += (unsigned long)due - this->maxSteps;
+		this->accumulator = 0.0;
+		return this->maxSteps;
+	}
+	this->accumulator -= due * this->stepSeconds;
+	return (unsigned int)due;
+}
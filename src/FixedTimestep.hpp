@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FIXEDTIMESTEP_INCLUDED_
+#define _FIXEDTIMESTEP_INCLUDED_
+
+
+/**
+ * Turns elapsed wall clock time into a number of fixed size simulation steps.
+ *
+ * Time that does not make up a whole step is carried over to the next frame. If more than
+ * maxSteps would be due (e.g. after a stall) the backlog is dropped, so the simulation slows
+ * down instead of spiralling.
+ */
+class FixedTimestep
+{
+public:
+	FixedTimestep( double rate, unsigned int maxSteps );
+	virtual ~FixedTimestep();
+
+	unsigned int advance( double seconds );
+
+	double getStepSeconds() const
+	{
+		return this->stepSeconds;
+	}
+
+	unsigned int getMaxSteps() const
+	{
+		return this->maxSteps;
+	}
+
+	unsigned long getDroppedSteps() const
+	{
+		return this->droppedSteps;
+	}
+
+private:
+	double stepSeconds;
+	unsigned int maxSteps;
+	double accumulator = 0.0;
+	unsigned long droppedSteps = 0;
+};
+
+
+#endif
@@ -26,40 +26,63 @@
 #include <stdlib.h>
 
 
-FrameBuffer2D::FrameBuffer2D( unsigned int width, unsigned int height, GLint internalFormat )
+FrameBuffer2D::FrameBuffer2D( unsigned int width, unsigned int height, GLint internalFormat, GLenum type )
 {
 	GLES2_ERROR_CHECK_UNHANDLED();
 
-	this->texture = new Texture2D( width, height, internalFormat, GL_NEAREST, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE );
+	this->texture = new Texture2D( width, height, internalFormat, GL_NEAREST, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, type );
 
 	glGenFramebuffers( 1, &this->id );
 	GLES2_ERROR_CHECK("glGenFramebuffers");
 
-	glBindFramebuffer( GL_FRAMEBUFFER, this->id );
-	GLES2_ERROR_CHECK("glBindFramebuffer");
+	GLState::bindFramebuffer( this->id );
 
 	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture->getID(), 0 );
 	GLES2_ERROR_CHECK("glFramebufferTexture2D");
 	if( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+	{
+		// nothing else owns them yet
+		GLState::bindFramebuffer( 0 );
+		glDeleteFramebuffers( 1, &this->id );
+		GLState::forgetFramebuffer( this->id );
+		delete this->texture;
 		throw RUNTIME_ERROR( "Framebuffer is not complete!" );
+	}
 
+	this->width = width;
+	this->height = height;
+
+	this->clear( 0.5f, 0.5f, 0.5f, 0.5f );
+
+	GLState::bindFramebuffer( 0 );
+}
+
+
+void FrameBuffer2D::readPixels( void * pixels ) const
+{
+	this->bind();
+	// GL_RGBA and GL_UNSIGNED_BYTE is the only combination every implementation has to support
+	glReadPixels( 0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, pixels );
+	GLES2_ERROR_CHECK("glReadPixels");
+}
+
+
+void FrameBuffer2D::clear( GLfloat r, GLfloat g, GLfloat b, GLfloat a ) const
+{
+	this->bind( false );
+	GLState::setScissor( false );
 	GLfloat oldClearColor[4];
 	glGetFloatv( GL_COLOR_CLEAR_VALUE, oldClearColor );
-	glClearColor( 0.5f, 0.5f, 0.5f, 0.5f );
+	glClearColor( r, g, b, a );
 	glClear( GL_COLOR_BUFFER_BIT );
 	glClearColor( oldClearColor[0], oldClearColor[1], oldClearColor[2], oldClearColor[3] );
 	GLES2_ERROR_CHECK("glClearColor");
-
-	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
-	GLES2_ERROR_CHECK("glBindFramebuffer");
-
-	this->width = width;
-	this->height = height;
 }
 
 
 FrameBuffer2D::~FrameBuffer2D()
 {
 	glDeleteFramebuffers( 1, &this->id );
+	GLState::forgetFramebuffer( this->id );
 	delete this->texture;
 }
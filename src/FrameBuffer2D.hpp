@@ -22,6 +22,7 @@
 
 
 #include "Error.hpp"
+#include "GLState.hpp"
 
 #include <string>
 
@@ -38,19 +39,21 @@ public:
 	FrameBuffer2D & operator=( const FrameBuffer2D & ) = delete;
 
 
-	FrameBuffer2D( unsigned int width, unsigned int height, GLint internalFormat );
+	FrameBuffer2D( unsigned int width, unsigned int height, GLint internalFormat, GLenum type = GL_UNSIGNED_BYTE );
 
 	virtual ~FrameBuffer2D();
 
-	void bind() const
+	void bind( bool setViewport = true ) const
 	{
-		GLES2_ERROR_CHECK_UNHANDLED();
-		glViewport( 0, 0, this->width, this->height );
-		GLES2_ERROR_CHECK("glViewport");
-		glBindFramebuffer( GL_FRAMEBUFFER, this->id );
-		GLES2_ERROR_CHECK("glBindFramebuffer");
+		if( setViewport )
+			GLState::viewport( 0, 0, this->width, this->height );
+		GLState::bindFramebuffer( this->id );
 	}
 
+	void readPixels( void * pixels ) const;
+	// a new framebuffer is cleared to grey
+	void clear( GLfloat r, GLfloat g, GLfloat b, GLfloat a ) const;
+
 	const GLuint & getID() const
 	{
 		return this->id;
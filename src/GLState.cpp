@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GLState.hpp"
+
+#include <exceptions.hpp>
+
+
+GLuint GLState::currentProgram = GLState::unknown;
+GLuint GLState::currentArrayBuffer = GLState::unknown;
+GLuint GLState::currentElementArrayBuffer = GLState::unknown;
+GLuint GLState::currentTextureUnit = GLState::unknown;
+GLuint GLState::currentTextures[GLState::maxTextureUnits];
+GLuint GLState::currentFramebuffer = GLState::unknown;
+GLint GLState::currentViewport[4] = { -1, -1, -1, -1 };
+GLuint GLState::currentScissor = GLState::unknown;
+GLint GLState::currentScissorBox[4] = { -1, -1, -1, -1 };
+GLuint GLState::currentBlend = GLState::unknown;
+GLenum GLState::currentBlendFunc[2] = { GLState::unknown, GLState::unknown };
+GLState::Attribute GLState::currentAttributes[GLState::maxAttributes];
+uint32_t GLState::enabledAttributes = 0;
+uint32_t GLState::knownAttributes = 0;
+uint32_t GLState::instancedAttributes = 0;
+uint32_t GLState::knownDivisors = 0;
+
+PFNGLVERTEXATTRIBDIVISOREXTPROC GLState::vertexAttribDivisor = nullptr;
+
+unsigned long GLState::calls = 0;
+unsigned long GLState::saved = 0;
+
+
+void GLState::invalidate()
+{
+	currentProgram = unknown;
+	currentArrayBuffer = unknown;
+	currentElementArrayBuffer = unknown;
+	currentTextureUnit = unknown;
+	for( GLuint & texture : currentTextures )
+		texture = unknown;
+	currentFramebuffer = unknown;
+	for( GLint & value : currentViewport )
+		value = -1;
+	currentScissor = unknown;
+	for( GLint & value : currentScissorBox )
+		value = -1;
+	currentBlend = unknown;
+	currentBlendFunc[0] = currentBlendFunc[1] = unknown;
+	for( Attribute & attribute : currentAttributes )
+		attribute.buffer = unknown;
+	enabledAttributes = 0;
+	knownAttributes = 0;
+	instancedAttributes = 0;
+	knownDivisors = 0;
+}
+
+
+void GLState::vertexAttribPointer( GLuint index, GLuint buffer, GLint size, GLenum type, GLboolean normalized, GLsizei stride, size_t offset )
+{
+	if( index >= maxAttributes )
+		throw RUNTIME_ERROR( "Attribute index out of range" );
+
+	calls++;
+	Attribute & current = currentAttributes[index];
+	if( current.buffer == buffer && current.size == size && current.type == type && current.normalized == normalized && current.stride == stride && current.offset == offset )
+	{
+		saved++;
+		return;
+	}
+	current.buffer = buffer;
+	current.size = size;
+	current.type = type;
+	current.normalized = normalized;
+	current.stride = stride;
+	current.offset = offset;
+
+	bindBuffer( buffer );
+	GLES2_ERROR_CHECK_UNHANDLED();
+	glVertexAttribPointer( index, size, type, normalized, stride, (const void*)offset );
+	GLES2_ERROR_CHECK("glVertexAttribPointer");
+}
+
+
+void GLState::enableVertexAttribArrays( uint32_t mask, uint32_t instancedMask )
+{
+	if( instancedMask && !vertexAttribDivisor )
+		throw RUNTIME_ERROR( "Instanced arrays are not available" );
+
+	GLES2_ERROR_CHECK_UNHANDLED();
+	for( unsigned int i = 0; i < maxAttributes; i++ )
+	{
+		uint32_t bit = 1u << i;
+		bool known = knownAttributes & bit;
+		// arrays that are known to be disabled and stay disabled are not worth counting
+		if( known && !( ( mask | enabledAttributes ) & bit ) )
+			continue;
+
+		calls++;
+		if( known && ( enabledAttributes & bit ) == ( mask & bit ) )
+		{
+			saved++;
+		}
+		else
+		{
+			if( mask & bit )
+				glEnableVertexAttribArray( i );
+			else
+				glDisableVertexAttribArray( i );
+			GLES2_ERROR_CHECK("glEnableVertexAttribArray");
+			enabledAttributes = ( enabledAttributes & ~bit ) | ( mask & bit );
+			knownAttributes |= bit;
+		}
+
+		// the divisor only matters for enabled arrays - without the extension it is always 0
+		if( !( mask & bit ) || !vertexAttribDivisor )
+			continue;
+		calls++;
+		if( ( knownDivisors & bit ) && ( instancedAttributes & bit ) == ( instancedMask & bit ) )
+		{
+			saved++;
+			continue;
+		}
+		vertexAttribDivisor( i, ( instancedMask & bit ) ? 1 : 0 );
+		GLES2_ERROR_CHECK("glVertexAttribDivisorEXT");
+		instancedAttributes = ( instancedAttributes & ~bit ) | ( instancedMask & bit );
+		knownDivisors |= bit;
+	}
+}
+
+
+void GLState::forgetProgram( GLuint program )
+{
+	// stays in use until another program is - but its name may come back for a new one
+	if( currentProgram == program )
+		currentProgram = unknown;
+}
+
+
+void GLState::forgetBuffer( GLuint buffer )
+{
+	if( currentArrayBuffer == buffer )
+		currentArrayBuffer = 0;
+	if( currentElementArrayBuffer == buffer )
+		currentElementArrayBuffer = 0;
+	for( Attribute & attribute : currentAttributes )
+	{
+		if( attribute.buffer == buffer )
+			attribute.buffer = unknown;
+	}
+}
+
+
+void GLState::forgetTexture( GLuint texture )
+{
+	for( GLuint & current : currentTextures )
+	{
+		if( current == texture )
+			current = 0;
+	}
+}
+
+
+void GLState::forgetFramebuffer( GLuint framebuffer )
+{
+	if( currentFramebuffer == framebuffer )
+		currentFramebuffer = 0;
+}
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GLSTATE_INCLUDED_
+#define _GLSTATE_INCLUDED_
+
+
+#include "Error.hpp"
+
+#include <stdint.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+
+/**
+ * Shadows the GL state the renderer touches and skips calls that would not change it.
+ *
+ * There is only one context, so the state is static. Everything that binds programs, buffers,
+ * textures or framebuffers, changes the viewport, the scissor box, the blending or vertex attributes has to go
+ * through here - otherwise the shadow copy is wrong and necessary calls get skipped.
+ * Deleted objects must be forgotten, because GL reuses their names.
+ */
+class GLState
+{
+public:
+	static const unsigned int maxTextureUnits = 8;
+	static const unsigned int maxAttributes = 16;
+
+	GLState() = delete;
+
+	// forgets everything - the next call of each kind goes through
+	static void invalidate();
+
+	static void useProgram( GLuint program )
+	{
+		if( !changed( program, currentProgram ) )
+			return;
+		GLES2_ERROR_CHECK_UNHANDLED();
+		glUseProgram( program );
+		GLES2_ERROR_CHECK("glUseProgram");
+	}
+
+	static void bindBuffer( GLuint buffer )
+	{
+		if( !changed( buffer, currentArrayBuffer ) )
+			return;
+		GLES2_ERROR_CHECK_UNHANDLED();
+		glBindBuffer( GL_ARRAY_BUFFER, buffer );
+		GLES2_ERROR_CHECK("glBindBuffer");
+	}
+
+	static void bindElementBuffer( GLuint buffer )
+	{
+		if( !changed( buffer, currentElementArrayBuffer ) )
+			return;
+		GLES2_ERROR_CHECK_UNHANDLED();
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, buffer );
+		GLES2_ERROR_CHECK("glBindBuffer");
+	}
+
+	static void activeTexture( unsigned int unit )
+	{
+		if( !changed( unit, currentTextureUnit ) )
+			return;
+		GLES2_ERROR_CHECK_UNHANDLED();
+		glActiveTexture( GL_TEXTURE0 + unit );
+		GLES2_ERROR_CHECK("glActiveTexture");
+	}
+
+	// binds to the active unit
+	static void bindTexture( GLuint texture )
+	{
+		if( currentTextureUnit >= maxTextureUnits )
+		{
+			// unknown unit - nothing to compare with, and afterwards any unit may have changed
+			calls++;
+			GLES2_ERROR_CHECK_UNHANDLED();
+			glBindTexture( GL_TEXTURE_2D, texture );
+			GLES2_ERROR_CHECK("glBindTexture");
+			for( GLuint & current : currentTextures )
+				current = unknown;
+			return;
+		}
+		if( !changed( texture, currentTextures[currentTextureUnit] ) )
+			return;
+		GLES2_ERROR_CHECK_UNHANDLED();
+		glBindTexture( GL_TEXTURE_2D, texture );
+		GLES2_ERROR_CHECK("glBindTexture");
+	}
+
+	static void bindTexture( unsigned int unit, GLuint texture )
+	{
+		// the unit only has to be activated if its binding changes
+		if( unit < maxTextureUnits && currentTextures[unit] == texture )
+		{
+			calls += 2;
+			saved += 2;
+			return;
+		}
+		activeTexture( unit );
+		bindTexture( texture );
+	}
+
+	static void bindFramebuffer( GLuint framebuffer )
+	{
+		if( !changed( framebuffer, currentFramebuffer ) )
+			return;
+		GLES2_ERROR_CHECK_UNHANDLED();
+		glBindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+		GLES2_ERROR_CHECK("glBindFramebuffer");
+	}
+
+	static void viewport( GLint x, GLint y, GLsizei width, GLsizei height )
+	{
+		calls++;
+		if( x == currentViewport[0] && y == currentViewport[1] && width == currentViewport[2] && height == currentViewport[3] )
+		{
+			saved++;
+			return;
+		}
+		currentViewport[0] = x;
+		currentViewport[1] = y;
+		currentViewport[2] = width;
+		currentViewport[3] = height;
+		GLES2_ERROR_CHECK_UNHANDLED();
+		glViewport( x, y, width, height );
+		GLES2_ERROR_CHECK("glViewport");
+	}
+
+	static void setScissor( bool enable )
+	{
+		GLuint value = enable;
+		if( !changed( value, currentScissor ) )
+			return;
+		GLES2_ERROR_CHECK_UNHANDLED();
+		if( enable )
+			glEnable( GL_SCISSOR_TEST );
+		else
+			glDisable( GL_SCISSOR_TEST );
+		GLES2_ERROR_CHECK("glEnable");
+	}
+
+	static void scissor( GLint x, GLint y, GLsizei width, GLsizei height )
+	{
+		calls++;
+		if( x == currentScissorBox[0] && y == currentScissorBox[1] && width == currentScissorBox[2] && height == currentScissorBox[3] )
+		{
+			saved++;
+			return;
+		}
+		currentScissorBox[0] = x;
+		currentScissorBox[1] = y;
+		currentScissorBox[2] = width;
+		currentScissorBox[3] = height;
+		GLES2_ERROR_CHECK_UNHANDLED();
+		glScissor( x, y, width, height );
+		GLES2_ERROR_CHECK("glScissor");
+	}
+
+	static void setBlend( bool enable )
+	{
+		GLuint value = enable;
+		if( !changed( value, currentBlend ) )
+			return;
+		GLES2_ERROR_CHECK_UNHANDLED();
+		if( enable )
+			glEnable( GL_BLEND );
+		else
+			glDisable( GL_BLEND );
+		GLES2_ERROR_CHECK("glEnable");
+	}
+
+	static void blendFunc( GLenum source, GLenum destination )
+	{
+		calls++;
+		if( source == currentBlendFunc[0] && destination == currentBlendFunc[1] )
+		{
+			saved++;
+			return;
+		}
+		currentBlendFunc[0] = source;
+		currentBlendFunc[1] = destination;
+		GLES2_ERROR_CHECK_UNHANDLED();
+		glBlendFunc( source, destination );
+		GLES2_ERROR_CHECK("glBlendFunc");
+	}
+
+	// binds buffer if necessary
+	static void vertexAttribPointer( GLuint index, GLuint buffer, GLint size, GLenum type, GLboolean normalized, GLsizei stride, size_t offset );
+	// enables exactly the arrays in mask (bit i for attribute i) - instanced arrays advance once per instance
+	static void enableVertexAttribArrays( uint32_t mask, uint32_t instancedMask = 0 );
+
+	// GL_EXT_instanced_arrays or GL_ANGLE_instanced_arrays - required for instancedMask
+	static void setVertexAttribDivisorFunction( PFNGLVERTEXATTRIBDIVISOREXTPROC function )
+	{
+		vertexAttribDivisor = function;
+	}
+
+	// GL unbinds deleted objects and reuses their names
+	static void forgetProgram( GLuint program );
+	static void forgetBuffer( GLuint buffer );
+	static void forgetTexture( GLuint texture );
+	static void forgetFramebuffer( GLuint framebuffer );
+
+	// calls made through GLState and how many of them were skipped
+	static unsigned long getCalls()
+	{
+		return calls;
+	}
+
+	static unsigned long getSavedCalls()
+	{
+		return saved;
+	}
+
+private:
+	// ~0 is never a valid name, unit or flag
+	static const GLuint unknown = ~0u;
+
+	static bool changed( GLuint value, GLuint & current )
+	{
+		calls++;
+		if( value == current )
+		{
+			saved++;
+			return false;
+		}
+		current = value;
+		return true;
+	}
+
+	struct Attribute
+	{
+		GLuint buffer;
+		GLint size;
+		GLenum type;
+		GLboolean normalized;
+		GLsizei stride;
+		size_t offset;
+	};
+
+	static GLuint currentProgram;
+	static GLuint currentArrayBuffer;
+	static GLuint currentElementArrayBuffer;
+	static GLuint currentTextureUnit;
+	static GLuint currentTextures[maxTextureUnits];
+	static GLuint currentFramebuffer;
+	static GLint currentViewport[4];
+	static GLuint currentScissor;
+	static GLint currentScissorBox[4];
+	static GLuint currentBlend;
+	static GLenum currentBlendFunc[2];
+	static Attribute currentAttributes[maxAttributes];
+	static uint32_t enabledAttributes;
+	static uint32_t knownAttributes; // enabled state is known for these
+	static uint32_t instancedAttributes;
+	static uint32_t knownDivisors;
+
+	static PFNGLVERTEXATTRIBDIVISOREXTPROC vertexAttribDivisor;
+
+	static unsigned long calls;
+	static unsigned long saved;
+};
+
+
+#endif
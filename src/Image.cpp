@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Image.hpp"
+#include "ETC.hpp"
+
+#include <exceptions.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <IL/il.h>
+
+
+static const uint8_t ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+// larger than any GL texture, and small enough that no level size overflows
+static const unsigned int maxDimension = 1 << 16;
+
+
+Image::Image( const std::string & file )
+	: file( file )
+{
+	{
+		std::ifstream stream( file, std::ios::binary );
+		uint8_t identifier[ sizeof(ktxIdentifier) ];
+		if( stream.read( (char *)identifier, sizeof(identifier) ) && std::equal( identifier, identifier + sizeof(identifier), ktxIdentifier ) )
+		{
+			this->loadKTX( stream );
+			return;
+		}
+	}
+
+	ILuint image;
+	ilGenImages( 1, &image );
+	ilBindImage( image );
+	if( !ilLoadImage( file.c_str() ) )
+	{
+		ilDeleteImages( 1, &image );
+		throw RUNTIME_ERROR( "Could not load \"" + file + "\"!" );
+	}
+
+	this->width = ilGetInteger( IL_IMAGE_WIDTH );
+	this->height = ilGetInteger( IL_IMAGE_HEIGHT );
+	this->format = ilGetInteger( IL_IMAGE_FORMAT );
+	this->type = ilGetInteger( IL_IMAGE_TYPE );
+	this->data.resize( ilGetInteger( IL_IMAGE_SIZE_OF_DATA ) );
+	std::memcpy( this->data.data(), ilGetData(), this->data.size() );
+	this->pixels = this->data.data();
+	this->size = this->data.size();
+
+	ilDeleteImages( 1, &image );
+}
+
+
+Image::Image( const std::string & file, unsigned int width, unsigned int height, GLenum format, GLenum type, bool compressed,
+              const uint8_t * pixels, size_t size, const std::vector< size_t > & levelOffsets )
+	: file( file ), width( width ), height( height ), format( format ), type( type ), compressed( compressed ),
+	  pixels( pixels ), size( size ), levelOffsets( levelOffsets )
+{
+	if( this->levelOffsets.empty() )
+		this->levelOffsets.push_back( 0 );
+}
+
+
+Image::~Image()
+{
+}
+
+
+void Image::loadKTX( std::ifstream & stream )
+{
+	// everything after the identifier
+	struct
+	{
+		uint32_t endianness;
+		uint32_t glType;
+		uint32_t glTypeSize;
+		uint32_t glFormat;
+		uint32_t glInternalFormat;
+		uint32_t glBaseInternalFormat;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t numberOfArrayElements;
+		uint32_t numberOfFaces;
+		uint32_t numberOfMipmapLevels;
+		uint32_t bytesOfKeyValueData;
+	} header;
+	if( !stream.read( (char *)&header, sizeof(header) ) )
+		throw RUNTIME_ERROR( "Truncated KTX header in \"" + this->file + "\"!" );
+	if( header.endianness != 0x04030201 )
+		throw RUNTIME_ERROR( "KTX file \"" + this->file + "\" has the wrong byte order!" );
+	if( header.glType != 0 || header.glFormat != 0 )
+		throw RUNTIME_ERROR( "KTX file \"" + this->file + "\" is not compressed!" );
+	if( !header.pixelWidth || !header.pixelHeight || header.pixelDepth || header.numberOfArrayElements || header.numberOfFaces != 1 )
+		throw RUNTIME_ERROR( "KTX file \"" + this->file + "\" is not a single 2D texture!" );
+	if( !getLevelSize( header.glInternalFormat, GL_UNSIGNED_BYTE, true, header.pixelWidth, header.pixelHeight ) )
+		throw RUNTIME_ERROR( "KTX file \"" + this->file + "\" has an unsupported format or size!" );
+	unsigned int chain = 1;
+	while( ( std::max( header.pixelWidth, header.pixelHeight ) >> chain ) > 0 )
+		chain++;
+	if( header.numberOfMipmapLevels > chain )
+		throw RUNTIME_ERROR( "KTX file \"" + this->file + "\" has more levels than its size allows!" );
+
+	this->width = header.pixelWidth;
+	this->height = header.pixelHeight;
+	this->format = header.glInternalFormat;
+	this->type = GL_UNSIGNED_BYTE;
+	this->compressed = true;
+	this->levelOffsets.clear();
+
+	// the orientation is not checked - glesPondTextureConverter writes the first row at the bottom like DevIL is set up to
+	stream.seekg( header.bytesOfKeyValueData, std::ios::cur );
+	unsigned int levels = std::max( 1u, header.numberOfMipmapLevels );
+	for( unsigned int level = 0; level < levels; level++ )
+	{
+		uint32_t size = 0;
+		if( !stream.read( (char *)&size, sizeof(size) ) )
+			throw RUNTIME_ERROR( "Truncated KTX file \"" + this->file + "\"!" );
+		// the ETC fallback decodes exactly this many bytes
+		if( size != getLevelSize( this->format, this->type, true, this->getWidth( level ), this->getHeight( level ) ) )
+			throw RUNTIME_ERROR( "KTX file \"" + this->file + "\" has a level of the wrong size!" );
+		this->levelOffsets.push_back( this->data.size() );
+		this->data.resize( this->data.size() + size );
+		if( !stream.read( (char *)this->data.data() + this->levelOffsets.back(), size ) )
+			throw RUNTIME_ERROR( "Truncated KTX file \"" + this->file + "\"!" );
+		// levels are padded to 4 bytes
+		stream.seekg( 3 - ( size + 3 ) % 4, std::ios::cur );
+	}
+	this->pixels = this->data.data();
+	this->size = this->data.size();
+}
+
+
+size_t Image::getLevelSize( GLenum format, GLenum type, bool compressed, unsigned int width, unsigned int height )
+{
+	if( !width || !height || width > maxDimension || height > maxDimension )
+		return 0;
+	if( compressed )
+		return ETC::isFormat( format ) ? ETC::getSize( format, width, height ) : 0;
+	if( type != GL_UNSIGNED_BYTE )
+		return 0;
+
+	unsigned int channels = 0;
+	switch( format )
+	{
+	case IL_ALPHA:
+	case IL_LUMINANCE:
+		channels = 1;
+		break;
+	case IL_LUMINANCE_ALPHA:
+		channels = 2;
+		break;
+	case IL_RGB:
+	case IL_BGR:
+		channels = 3;
+		break;
+	case IL_RGBA:
+	case IL_BGRA:
+		channels = 4;
+		break;
+	default:
+		return 0;
+	}
+	return (size_t)width * height * channels;
+}
+
+
+// the source pixels covered by one destination pixel and how much each of them contributes
+struct Footprint
+{
+	unsigned int first;
+	std::vector< float > weights;
+};
+
+
+static std::vector< Footprint > footprints( unsigned int source, unsigned int destination )
+{
+	std::vector< Footprint > result( destination );
+	double scale = (double)source / destination;
+	for( unsigned int i = 0; i < destination; i++ )
+	{
+		double begin = i * scale;
+		double end = ( i + 1 ) * scale;
+		result[i].first = (unsigned int)begin;
+		for( unsigned int j = result[i].first; j < end && j < source; j++ )
+			result[i].weights.push_back( ( std::min( end, j + 1.0 ) - std::max( begin, (double)j ) ) / scale );
+	}
+	return result;
+}
+
+
+// the channel holding alpha, -1 for formats without
+static int alphaChannel( GLenum format, unsigned int channels )
+{
+	if( ( format == IL_RGBA || format == IL_BGRA ) && channels == 4 )
+		return 3;
+	if( format == IL_LUMINANCE_ALPHA && channels == 2 )
+		return 1;
+	return -1;
+}
+
+
+bool Image::downscale( unsigned int maxWidth, unsigned int maxHeight )
+{
+	unsigned int width = maxWidth ? std::min( this->width, maxWidth ) : this->width;
+	unsigned int height = maxHeight ? std::min( this->height, maxHeight ) : this->height;
+	if( ( width == this->width && height == this->height ) || !width || !height )
+		return false;
+	if( this->compressed || this->type != GL_UNSIGNED_BYTE )
+		return false;
+
+	unsigned int channels = this->getSize( 0 ) / ( this->width * this->height );
+	// colours are filtered premultiplied, so transparent pixels do not darken the edges of opaque ones
+	int alpha = alphaChannel( this->format, channels );
+	std::vector< Footprint > columns = footprints( this->width, width );
+	std::vector< Footprint > rows = footprints( this->height, height );
+
+	// one destination row at a time, so even huge images only need two rows of floats
+	std::vector< uint8_t > data( width * height * channels );
+	std::vector< float > row( width * channels );
+	std::vector< float > sum( width * channels );
+	for( unsigned int y = 0; y < height; y++ )
+	{
+		std::fill( sum.begin(), sum.end(), 0.0f );
+		for( unsigned int j = 0; j < rows[y].weights.size(); j++ )
+		{
+			const uint8_t * source = this->pixels + ( rows[y].first + j ) * this->width * channels;
+			for( unsigned int x = 0; x < width; x++ )
+			{
+				const Footprint & column = columns[x];
+				for( unsigned int c = 0; c < channels; c++ )
+				{
+					float value = 0.0f;
+					for( unsigned int i = 0; i < column.weights.size(); i++ )
+					{
+						const uint8_t * pixel = source + ( column.first + i ) * channels;
+						float coverage = alpha >= 0 && (int)c != alpha ? pixel[alpha] / 255.0f : 1.0f;
+						value += column.weights[i] * coverage * pixel[c];
+					}
+					row[ x * channels + c ] = value;
+				}
+			}
+			for( unsigned int i = 0; i < sum.size(); i++ )
+				sum[i] += rows[y].weights[j] * row[i];
+		}
+		for( unsigned int x = 0; x < width; x++ )
+		{
+			const float * pixel = &sum[ x * channels ];
+			for( unsigned int c = 0; c < channels; c++ )
+			{
+				float value = pixel[c];
+				if( alpha >= 0 && (int)c != alpha )
+					value = pixel[alpha] > 0.0f ? value * 255.0f / pixel[alpha] : 0.0f;
+				data[ ( y * width + x ) * channels + c ] = (uint8_t)std::min( 255.0f, value + 0.5f );
+			}
+		}
+	}
+
+	this->data.swap( data );
+	this->pixels = this->data.data();
+	this->size = this->data.size();
+	this->levelOffsets.assign( 1, 0 );
+	this->width = width;
+	this->height = height;
+	return true;
+}
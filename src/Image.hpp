@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IMAGE_INCLUDED_
+#define _IMAGE_INCLUDED_
+
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#include <stdint.h>
+
+#include <GLES2/gl2.h>
+
+
+/**
+ * A decoded image in CPU memory, ready to be handed to glTexImage2D.
+ *
+ * KTX files are read without DevIL. They hold ETC compressed images (format is then the internal
+ * format for glCompressedTexImage2D) and may bring their own mipmap levels - see ETC.
+ * Images can also wrap pixels that live elsewhere, e.g. in an AssetPack. Those are only copied
+ * if the image is changed.
+ *
+ * Decoding does not touch GL, so images can be loaded on any thread - but DevIL itself
+ * must only be used by one thread at a time. The same goes for downscale(), which averages
+ * the covered source pixels, so even large reductions do not alias.
+ */
+class Image
+{
+public:
+	Image( const Image & ) = delete;
+	Image & operator=( const Image & ) = delete;
+
+	Image( const std::string & file );
+	// the pixels must outlive the image
+	Image( const std::string & file, unsigned int width, unsigned int height, GLenum format, GLenum type, bool compressed,
+	       const uint8_t * pixels, size_t size, const std::vector< size_t > & levelOffsets );
+	virtual ~Image();
+
+	// shrinks the image to at most maxWidth x maxHeight, 0 does not limit - returns false if nothing changed
+	// (compressed images are never changed)
+	bool downscale( unsigned int maxWidth, unsigned int maxHeight );
+
+	// the bytes of one tightly packed level, 0 if images of that format and type are not supported
+	static size_t getLevelSize( GLenum format, GLenum type, bool compressed, unsigned int width, unsigned int height );
+
+	const std::string & getFile() const
+	{
+		return this->file;
+	}
+
+	unsigned int getWidth() const
+	{
+		return this->width;
+	}
+
+	unsigned int getHeight() const
+	{
+		return this->height;
+	}
+
+	GLenum getFormat() const
+	{
+		return this->format;
+	}
+
+	GLenum getType() const
+	{
+		return this->type;
+	}
+
+	bool isCompressed() const
+	{
+		return this->compressed;
+	}
+
+	unsigned int getLevels() const
+	{
+		return this->levelOffsets.size();
+	}
+
+	unsigned int getWidth( unsigned int level ) const
+	{
+		return std::max( 1u, this->width >> level );
+	}
+
+	unsigned int getHeight( unsigned int level ) const
+	{
+		return std::max( 1u, this->height >> level );
+	}
+
+	const uint8_t * getData( unsigned int level = 0 ) const
+	{
+		return this->pixels + this->levelOffsets[level];
+	}
+
+	size_t getSize( unsigned int level = 0 ) const
+	{
+		return ( level + 1 < this->levelOffsets.size() ? this->levelOffsets[level+1] : this->size ) - this->levelOffsets[level];
+	}
+
+	size_t getTotalSize() const
+	{
+		return this->size;
+	}
+
+private:
+	void loadKTX( std::ifstream & stream );
+
+	std::string file;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	GLenum format = GL_RGBA;
+	GLenum type = GL_UNSIGNED_BYTE;
+	bool compressed = false;
+	std::vector< uint8_t > data; // all levels, empty if the pixels are not owned
+	const uint8_t * pixels = nullptr; // data or somewhere else
+	size_t size = 0;
+	std::vector< size_t > levelOffsets = { 0 };
+};
+
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ImageLoader.hpp"
+
+#include <exceptions.hpp>
+
+
+ImageLoader::ImageLoader()
+{
+	// started last - everything it uses must be constructed
+	this->worker = std::thread( &ImageLoader::workerMain, this );
+}
+
+
+ImageLoader::~ImageLoader()
+{
+	{
+		std::lock_guard< std::mutex > lock( this->mutex );
+		this->quit = true;
+	}
+	this->requestCondition.notify_all();
+	this->worker.join();
+}
+
+
+unsigned int ImageLoader::request( const std::string & file, unsigned int maxWidth, unsigned int maxHeight )
+{
+	unsigned int ticket;
+	{
+		std::lock_guard< std::mutex > lock( this->mutex );
+		ticket = this->nextTicket++;
+		Job & job = this->jobs[ticket];
+		job.file = file;
+		job.maxWidth = maxWidth;
+		job.maxHeight = maxHeight;
+		this->queue.push_back( ticket );
+	}
+	this->requestCondition.notify_one();
+	return ticket;
+}
+
+
+std::unique_ptr< Image > ImageLoader::take( unsigned int ticket )
+{
+	std::lock_guard< std::mutex > lock( this->mutex );
+	auto job = this->jobs.find( ticket );
+	if( job == this->jobs.end() )
+		throw RUNTIME_ERROR( "Unknown ticket" );
+	if( !job->second.done )
+		return nullptr;
+	return this->redeem( job );
+}
+
+
+std::unique_ptr< Image > ImageLoader::wait( unsigned int ticket )
+{
+	std::unique_lock< std::mutex > lock( this->mutex );
+	auto job = this->jobs.find( ticket );
+	if( job == this->jobs.end() )
+		throw RUNTIME_ERROR( "Unknown ticket" );
+	this->doneCondition.wait( lock, [&]{ return job->second.done; } );
+	return this->redeem( job );
+}
+
+
+void ImageLoader::cancel( unsigned int ticket )
+{
+	std::lock_guard< std::mutex > lock( this->mutex );
+	this->jobs.erase( ticket );
+}
+
+
+unsigned int ImageLoader::getPendingCount() const
+{
+	std::lock_guard< std::mutex > lock( this->mutex );
+	unsigned int pending = 0;
+	for( const auto & job : this->jobs )
+	{
+		if( !job.second.done )
+			pending++;
+	}
+	return pending;
+}
+
+
+std::unique_ptr< Image > ImageLoader::redeem( std::map< unsigned int, Job >::iterator job )
+{
+	std::unique_ptr< Image > image = std::move( job->second.image );
+	std::exception_ptr error = job->second.error;
+	this->jobs.erase( job );
+	if( error )
+		std::rethrow_exception( error );
+	return image;
+}
+
+
+void ImageLoader::workerMain()
+{
+	std::unique_lock< std::mutex > lock( this->mutex );
+	for(;;)
+	{
+		this->requestCondition.wait( lock, [this]{ return this->quit || !this->queue.empty(); } );
+		if( this->quit )
+			return;
+
+		unsigned int ticket = this->queue.front();
+		this->queue.pop_front();
+		auto job = this->jobs.find( ticket );
+		if( job == this->jobs.end() )
+			continue; // cancelled
+		std::string file = job->second.file;
+		unsigned int maxWidth = job->second.maxWidth;
+		unsigned int maxHeight = job->second.maxHeight;
+
+		// decoding takes long - requests, polls and cancellations must get through meanwhile
+		lock.unlock();
+		std::unique_ptr< Image > image;
+		std::exception_ptr error;
+		try
+		{
+			image.reset( new Image( file ) );
+			image->downscale( maxWidth, maxHeight );
+		}
+		catch( ... )
+		{
+			error = std::current_exception();
+		}
+		lock.lock();
+
+		// the job may have been cancelled while decoding
+		job = this->jobs.find( ticket );
+		if( job == this->jobs.end() )
+			continue;
+		job->second.image = std::move( image );
+		job->second.error = error;
+		job->second.done = true;
+		this->doneCondition.notify_all();
+	}
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IMAGELOADER_INCLUDED_
+#define _IMAGELOADER_INCLUDED_
+
+
+#include "Image.hpp"
+
+#include <string>
+#include <map>
+#include <deque>
+#include <memory>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+/**
+ * Decodes images on a background thread, so the GL thread only has to upload them.
+ *
+ * Every request() returns a ticket that is redeemed with take() (polling) or wait() (blocking)
+ * on the thread that owns the GL context. Decoding errors are rethrown there as well.
+ * DevIL keeps global state, so there is a single decoding thread, and nothing else may use
+ * DevIL while an ImageLoader exists. Images that are larger than needed are downscaled on
+ * that thread as well.
+ */
+class ImageLoader
+{
+public:
+	ImageLoader( const ImageLoader & ) = delete;
+	ImageLoader & operator=( const ImageLoader & ) = delete;
+
+	ImageLoader();
+	virtual ~ImageLoader();
+
+	// maxWidth and maxHeight limit the size of the image - see Image::downscale
+	unsigned int request( const std::string & file, unsigned int maxWidth = 0, unsigned int maxHeight = 0 );
+	// the decoded image if it is done, nullptr otherwise
+	std::unique_ptr< Image > take( unsigned int ticket );
+	std::unique_ptr< Image > wait( unsigned int ticket );
+	// forgets a request that is no longer needed - it is dropped as soon as possible
+	void cancel( unsigned int ticket );
+
+	// requests that are not decoded yet
+	unsigned int getPendingCount() const;
+
+private:
+	struct Job
+	{
+		std::string file;
+		unsigned int maxWidth = 0;
+		unsigned int maxHeight = 0;
+		std::unique_ptr< Image > image;
+		std::exception_ptr error;
+		bool done = false;
+	};
+
+	std::unique_ptr< Image > redeem( std::map< unsigned int, Job >::iterator job );
+	void workerMain();
+
+	std::map< unsigned int, Job > jobs;
+	std::deque< unsigned int > queue;
+	unsigned int nextTicket = 0;
+	bool quit = false;
+
+	mutable std::mutex mutex;
+	std::condition_variable requestCondition;
+	std::condition_variable doneCondition;
+	std::thread worker;
+};
+
+
+#endif
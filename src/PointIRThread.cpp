@@ -0,0 +1,500 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PointIRThread.hpp"
+
+#include <exceptions.hpp>
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+
+static const unsigned int queueSize = 16;
+static const unsigned int frameRingSize = 4; // one held by the render thread, one queued, two to receive into
+
+
+PointIRThread::PointIRThread( const std::function< void() > & notify, const std::string & videoSocketName, unsigned int frameWidth, unsigned int frameHeight, DBusBusType busType, int callTimeout )
+	: notify( notify ), callTimeout( callTimeout ), requests( queueSize ), replies( queueSize ), frames( frameRingSize ), releasedFrames( frameRingSize )
+{
+	this->dbus.reset( new PointIR::DBusClient( busType ) );
+	try
+	{
+		if( !videoSocketName.empty() )
+			this->video.reset( new PointIR::VideoSocketClient( videoSocketName, frameWidth, frameHeight, frameRingSize ) );
+	}
+	catch( const std::exception & e )
+	{
+		std::cerr << "No PointIR video: " << e.what() << "\n";
+	}
+
+	this->epollFD = epoll_create1( EPOLL_CLOEXEC );
+	if( this->epollFD < 0 )
+		throw SYSTEM_ERROR( errno, "epoll_create1" );
+	this->eventFD = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	if( this->eventFD < 0 )
+	{
+		int error = errno;
+		close( this->epollFD );
+		throw SYSTEM_ERROR( error, "eventfd" );
+	}
+	struct epoll_event event;
+	std::memset( &event, 0, sizeof(event) );
+	event.events = EPOLLIN;
+	event.data.fd = this->eventFD;
+	if( epoll_ctl( this->epollFD, EPOLL_CTL_ADD, this->eventFD, &event ) )
+	{
+		int error = errno;
+		close( this->eventFD );
+		close( this->epollFD );
+		throw SYSTEM_ERROR( error, "epoll_ctl" );
+	}
+	if( this->video )
+	{
+		event.data.fd = this->video->getFD();
+		if( epoll_ctl( this->epollFD, EPOLL_CTL_ADD, this->video->getFD(), &event ) )
+		{
+			int error = errno;
+			close( this->eventFD );
+			close( this->epollFD );
+			throw SYSTEM_ERROR( error, "epoll_ctl" );
+		}
+	}
+
+	// the connection is only touched by the thread from here on
+	if( !dbus_connection_set_watch_functions( this->dbus->getConnection(), addWatch, removeWatch, toggleWatch, this, nullptr )
+	 || !dbus_connection_set_timeout_functions( this->dbus->getConnection(), addTimeout, removeTimeout, toggleTimeout, this, nullptr ) )
+	{
+		dbus_connection_set_watch_functions( this->dbus->getConnection(), nullptr, nullptr, nullptr, nullptr, nullptr );
+		close( this->eventFD );
+		close( this->epollFD );
+		throw RUNTIME_ERROR( "Could not integrate the DBus connection" );
+	}
+
+	this->thread = std::thread( &PointIRThread::threadMain, this );
+}
+
+
+PointIRThread::~PointIRThread()
+{
+	this->quit = true;
+	this->wake();
+	this->thread.join();
+	Reply reply;
+	while( this->replies.pop( reply ) )
+	{
+		if( reply.fd >= 0 )
+			close( reply.fd );
+	}
+	dbus_connection_set_watch_functions( this->dbus->getConnection(), nullptr, nullptr, nullptr, nullptr, nullptr );
+	dbus_connection_set_timeout_functions( this->dbus->getConnection(), nullptr, nullptr, nullptr, nullptr, nullptr );
+	close( this->eventFD );
+	close( this->epollFD );
+}
+
+
+bool PointIRThread::requestCalibrationImage( unsigned int width, unsigned int height )
+{
+	Request request;
+	request.call = Call::CalibrationImage;
+	request.width = width;
+	request.height = height;
+	return this->request( request );
+}
+
+
+bool PointIRThread::requestCalibrationImageFile( unsigned int width, unsigned int height )
+{
+	Request request;
+	request.call = Call::CalibrationImageFile;
+	request.width = width;
+	request.height = height;
+	return this->request( request );
+}
+
+
+bool PointIRThread::requestCalibrate()
+{
+	Request request;
+	request.call = Call::Calibrate;
+	return this->request( request );
+}
+
+
+bool PointIRThread::requestSaveCalibrationData()
+{
+	Request request;
+	request.call = Call::SaveCalibrationData;
+	return this->request( request );
+}
+
+
+bool PointIRThread::takeReply( Reply & reply )
+{
+	return this->replies.pop( reply );
+}
+
+
+const PointIR_Frame * PointIRThread::takeFrame()
+{
+	int slot;
+	bool taken = false;
+	while( this->frames.pop( slot ) )
+	{
+		// there are no more slots than the queue holds, so this always fits
+		if( this->heldFrame >= 0 )
+			this->releasedFrames.push( this->heldFrame );
+		this->heldFrame = slot;
+		taken = true;
+	}
+	return taken ? this->video->getFrame( this->heldFrame ) : nullptr;
+}
+
+
+bool PointIRThread::request( const Request & request )
+{
+	if( !this->requests.push( request ) )
+		return false;
+	this->wake();
+	return true;
+}
+
+
+void PointIRThread::wake()
+{
+	uint64_t one = 1;
+	if( write( this->eventFD, &one, sizeof(one) ) < 0 && errno != EAGAIN )
+		std::cerr << "Could not wake the PointIR thread: " << std::strerror( errno ) << "\n";
+}
+
+
+void PointIRThread::threadMain()
+{
+	struct epoll_event events[8];
+	while( !this->quit )
+	{
+		int count = epoll_wait( this->epollFD, events, sizeof(events) / sizeof(events[0]), this->getTimeout() );
+		if( count < 0 )
+		{
+			if( errno == EINTR )
+				continue;
+			std::cerr << "PointIR thread: epoll_wait failed: " << std::strerror( errno ) << "\n";
+			return;
+		}
+
+		for( int i = 0; i < count; i++ )
+		{
+			int fd = events[i].data.fd;
+			if( fd == this->eventFD )
+			{
+				uint64_t value;
+				while( read( this->eventFD, &value, sizeof(value) ) > 0 );
+				Request request;
+				while( !this->quit && this->requests.pop( request ) )
+					this->handleRequest( request );
+			}
+			else if( this->video && fd == this->video->getFD() )
+			{
+				if( events[i].events & ( EPOLLERR | EPOLLHUP ) )
+				{
+					std::cerr << "PointIR thread: the video socket was closed\n";
+					epoll_ctl( this->epollFD, EPOLL_CTL_DEL, fd, &events[i] );
+					continue;
+				}
+				if( this->receiveFrames() && this->notifyFrames )
+					this->published = true;
+			}
+			else
+			{
+				auto w = this->watches.find( fd );
+				if( w == this->watches.end() )
+					continue;
+				unsigned int flags = 0;
+				if( events[i].events & EPOLLIN )
+					flags |= DBUS_WATCH_READABLE;
+				if( events[i].events & EPOLLOUT )
+					flags |= DBUS_WATCH_WRITABLE;
+				if( events[i].events & EPOLLERR )
+					flags |= DBUS_WATCH_ERROR;
+				if( events[i].events & EPOLLHUP )
+					flags |= DBUS_WATCH_HANGUP;
+				// handling may add or remove watches, so work on a copy
+				std::vector< DBusWatch * > fdWatches( w->second );
+				for( DBusWatch * watch : fdWatches )
+				{
+					if( dbus_watch_get_enabled( watch ) )
+						dbus_watch_handle( watch, flags );
+				}
+			}
+		}
+
+		this->handleTimeouts();
+
+		// runs the callbacks of the calls that were answered
+		while( dbus_connection_dispatch( this->dbus->getConnection() ) == DBUS_DISPATCH_DATA_REMAINS );
+
+		if( this->published && this->notify )
+			this->notify();
+		this->published = false;
+	}
+}
+
+
+void PointIRThread::handleRequest( const Request & request )
+{
+	Call call = request.call;
+	auto replyBool = [this, call]( bool result, const std::string & error )
+	{
+		Reply reply;
+		reply.call = call;
+		reply.success = result && error.empty();
+		reply.error = error;
+		this->publishReply( std::move( reply ) );
+	};
+	try
+	{
+		switch( request.call )
+		{
+		case Call::CalibrationImage:
+			if( !this->dbus->canPassFileDescriptors() )
+			{
+				this->sendCalibrationImageFile( request );
+				break;
+			}
+			this->dbus->getCalibrationImageAsync( request.width, request.height, [this, request]( int fd, unsigned int width, unsigned int height, const std::string & error )
+			{
+				// daemons that cannot share memory still write files
+				if( fd < 0 && error.compare( 0, std::strlen( DBUS_ERROR_UNKNOWN_METHOD ), DBUS_ERROR_UNKNOWN_METHOD ) == 0 )
+				{
+					this->sendCalibrationImageFile( request );
+					return;
+				}
+				Reply reply;
+				reply.call = Call::CalibrationImage;
+				reply.success = fd >= 0;
+				reply.fd = fd;
+				reply.width = width;
+				reply.height = height;
+				reply.error = error;
+				this->publishReply( std::move( reply ) );
+			}, this->callTimeout );
+			break;
+		case Call::CalibrationImageFile:
+			this->sendCalibrationImageFile( request );
+			break;
+		case Call::Calibrate:
+			this->dbus->calibrateAsync( replyBool, this->callTimeout );
+			break;
+		case Call::SaveCalibrationData:
+			this->dbus->saveCalibrationDataAsync( replyBool, this->callTimeout );
+			break;
+		}
+	}
+	catch( const std::exception & e )
+	{
+		replyBool( false, e.what() );
+	}
+}
+
+
+void PointIRThread::sendCalibrationImageFile( const Request & request )
+{
+	Call call = request.call;
+	try
+	{
+		this->dbus->getCalibrationImageFileAsync( request.width, request.height, [this, call]( const std::string & file, const std::string & error )
+		{
+			Reply reply;
+			reply.call = call;
+			reply.success = !file.empty() && error.empty();
+			reply.file = file;
+			reply.error = error;
+			this->publishReply( std::move( reply ) );
+		}, this->callTimeout );
+	}
+	catch( const std::exception & e )
+	{
+		Reply reply;
+		reply.call = call;
+		reply.error = e.what();
+		this->publishReply( std::move( reply ) );
+	}
+}
+
+
+void PointIRThread::publishReply( Reply && reply )
+{
+	int fd = reply.fd;
+	if( !this->replies.push( std::move( reply ) ) )
+	{
+		std::cerr << "PointIR thread: reply queue is full, reply dropped\n";
+		if( fd >= 0 )
+			close( fd );
+	}
+	this->published = true;
+}
+
+
+bool PointIRThread::receiveFrames()
+{
+	int slot = -1;
+	while( this->releasedFrames.pop( slot ) )
+		this->video->releaseFrame( slot );
+
+	try
+	{
+		slot = this->video->receiveFrame();
+	}
+	catch( const std::exception & e )
+	{
+		std::cerr << "PointIR thread: " << e.what() << "\n";
+		return false;
+	}
+	this->droppedFrames = this->video->getDroppedFrames();
+	if( slot < 0 )
+		return false;
+
+	// the render thread sees the pixels once it pops the slot
+	this->frames.push( slot );
+	return true;
+}
+
+
+void PointIRThread::updateWatches( int fd )
+{
+	uint32_t events = 0;
+	auto w = this->watches.find( fd );
+	if( w != this->watches.end() )
+	{
+		for( DBusWatch * watch : w->second )
+		{
+			if( !dbus_watch_get_enabled( watch ) )
+				continue;
+			unsigned int flags = dbus_watch_get_flags( watch );
+			if( flags & DBUS_WATCH_READABLE )
+				events |= EPOLLIN;
+			if( flags & DBUS_WATCH_WRITABLE )
+				events |= EPOLLOUT;
+		}
+	}
+
+	struct epoll_event event;
+	std::memset( &event, 0, sizeof(event) );
+	event.events = events;
+	event.data.fd = fd;
+	// errors and hangups are always reported, so a registered fd without events stays registered
+	if( w == this->watches.end() )
+		epoll_ctl( this->epollFD, EPOLL_CTL_DEL, fd, &event );
+	else if( epoll_ctl( this->epollFD, EPOLL_CTL_MOD, fd, &event ) < 0 && errno == ENOENT )
+		epoll_ctl( this->epollFD, EPOLL_CTL_ADD, fd, &event );
+}
+
+
+dbus_bool_t PointIRThread::addWatch( DBusWatch * watch, void * data )
+{
+	PointIRThread * self = (PointIRThread *)data;
+	int fd = dbus_watch_get_unix_fd( watch );
+	self->watches[fd].push_back( watch );
+	self->updateWatches( fd );
+	return TRUE;
+}
+
+
+void PointIRThread::removeWatch( DBusWatch * watch, void * data )
+{
+	PointIRThread * self = (PointIRThread *)data;
+	int fd = dbus_watch_get_unix_fd( watch );
+	auto w = self->watches.find( fd );
+	if( w == self->watches.end() )
+		return;
+	w->second.erase( std::remove( w->second.begin(), w->second.end(), watch ), w->second.end() );
+	if( w->second.empty() )
+		self->watches.erase( w );
+	self->updateWatches( fd );
+}
+
+
+void PointIRThread::toggleWatch( DBusWatch * watch, void * data )
+{
+	PointIRThread * self = (PointIRThread *)data;
+	self->updateWatches( dbus_watch_get_unix_fd( watch ) );
+}
+
+
+int PointIRThread::getTimeout() const
+{
+	if( this->timeouts.empty() )
+		return -1;
+	auto due = this->timeouts.begin()->second;
+	for( const auto & t : this->timeouts )
+		due = std::min( due, t.second );
+	auto remaining = std::chrono::duration_cast< std::chrono::milliseconds >( due - std::chrono::steady_clock::now() ).count();
+	// rounded up, so the timeout is due when epoll returns
+	return std::max( 0, (int)remaining + 1 );
+}
+
+
+void PointIRThread::handleTimeouts()
+{
+	auto now = std::chrono::steady_clock::now();
+	std::vector< DBusTimeout * > due;
+	for( auto & t : this->timeouts )
+	{
+		if( t.second > now )
+			continue;
+		due.push_back( t.first );
+		// timeouts repeat until they are removed
+		t.second = now + std::chrono::milliseconds( dbus_timeout_get_interval( t.first ) );
+	}
+	// handling may remove timeouts
+	for( DBusTimeout * timeout : due )
+	{
+		if( this->timeouts.count( timeout ) )
+			dbus_timeout_handle( timeout );
+	}
+}
+
+
+dbus_bool_t PointIRThread::addTimeout( DBusTimeout * timeout, void * data )
+{
+	toggleTimeout( timeout, data );
+	return TRUE;
+}
+
+
+void PointIRThread::removeTimeout( DBusTimeout * timeout, void * data )
+{
+	PointIRThread * self = (PointIRThread *)data;
+	self->timeouts.erase( timeout );
+}
+
+
+void PointIRThread::toggleTimeout( DBusTimeout * timeout, void * data )
+{
+	PointIRThread * self = (PointIRThread *)data;
+	if( dbus_timeout_get_enabled( timeout ) )
+		self->timeouts[timeout] = std::chrono::steady_clock::now() + std::chrono::milliseconds( dbus_timeout_get_interval( timeout ) );
+	else
+		self->timeouts.erase( timeout );
+}
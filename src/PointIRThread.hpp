@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _POINTIRTHREAD_INCLUDED_
+#define _POINTIRTHREAD_INCLUDED_
+
+
+#include "SPSCQueue.hpp"
+#include "VideoSocketClient.hpp"
+#include "DBusClient.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include <stdint.h>
+
+
+/**
+ * Talks to the PointIR daemon on a thread of its own, so the render loop never waits for it.
+ *
+ * The thread sleeps in epoll on the video socket, the file descriptors of the DBus connection and
+ * an eventfd that signals new requests, until the next DBus timeout is due. DBus calls are sent
+ * asynchronously, so a slow daemon delays neither the replies to other calls nor camera frames.
+ * Requests, replies and camera frames travel through SPSCQueues. Frames are not copied - the
+ * render thread gets the slot of the receive ring a frame arrived in and hands it back once it is
+ * done, so if it holds all of them, new frames are dropped.
+ */
+class PointIRThread
+{
+public:
+	enum class Call
+	{
+		CalibrationImage,
+		CalibrationImageFile,
+		Calibrate,
+		SaveCalibrationData
+	};
+
+	struct Reply
+	{
+		Call call = Call::Calibrate;
+		bool success = false;
+		std::string file; // CalibrationImageFile, and CalibrationImage if the daemon cannot share memory
+		int fd = -1; // CalibrationImage - RGBA8 pixels, owned by whoever takes the reply
+		unsigned int width = 0;
+		unsigned int height = 0;
+		std::string error;
+	};
+
+	PointIRThread( const PointIRThread & ) = delete;
+	PointIRThread & operator=( const PointIRThread & ) = delete;
+
+	// notify is called on the I/O thread whenever replies were published - and frames, see setNotifyFrames().
+	// An empty videoSocketName goes without video, callTimeout is in milliseconds (-1 is the DBus default).
+	PointIRThread( const std::function< void() > & notify, const std::string & videoSocketName = "/tmp/PointIR.video.socket", unsigned int frameWidth = 640, unsigned int frameHeight = 480, DBusBusType busType = DBUS_BUS_SYSTEM, int callTimeout = -1 );
+	virtual ~PointIRThread();
+
+	// render thread only - false if the request queue is full
+	bool requestCalibrationImage( unsigned int width, unsigned int height );
+	bool requestCalibrationImageFile( unsigned int width, unsigned int height );
+	bool requestCalibrate();
+	bool requestSaveCalibrationData();
+	bool takeReply( Reply & reply );
+	// the newest frame, valid until the next call that returns one - nullptr if nothing arrived
+	const PointIR_Frame * takeFrame();
+
+	// off by default, so the frames do not wake a render loop that does not look at them
+	void setNotifyFrames( bool notifyFrames )
+	{
+		this->notifyFrames = notifyFrames;
+	}
+
+	bool hasVideo() const
+	{
+		return this->video != nullptr;
+	}
+
+	unsigned int getDroppedFrames() const
+	{
+		return this->droppedFrames;
+	}
+
+private:
+	struct Request
+	{
+		Call call = Call::Calibrate;
+		unsigned int width = 0;
+		unsigned int height = 0;
+	};
+
+	bool request( const Request & request );
+	void wake();
+	void threadMain();
+	void handleRequest( const Request & request );
+	void sendCalibrationImageFile( const Request & request );
+	void publishReply( Reply && reply );
+	bool receiveFrames();
+	void updateWatches( int fd );
+	int getTimeout() const;
+	void handleTimeouts();
+
+	static dbus_bool_t addWatch( DBusWatch * watch, void * data );
+	static void removeWatch( DBusWatch * watch, void * data );
+	static void toggleWatch( DBusWatch * watch, void * data );
+	static dbus_bool_t addTimeout( DBusTimeout * timeout, void * data );
+	static void removeTimeout( DBusTimeout * timeout, void * data );
+	static void toggleTimeout( DBusTimeout * timeout, void * data );
+
+	std::function< void() > notify;
+	int callTimeout;
+	std::unique_ptr< PointIR::VideoSocketClient > video;
+	std::unique_ptr< PointIR::DBusClient > dbus;
+
+	int epollFD = -1;
+	int eventFD = -1;
+	std::map< int, std::vector< DBusWatch * > > watches; // by file descriptor, I/O thread only once running
+	std::map< DBusTimeout *, std::chrono::steady_clock::time_point > timeouts; // enabled ones by when they are due
+	bool published = false;
+
+	SPSCQueue< Request > requests;
+	SPSCQueue< Reply > replies;
+	SPSCQueue< int > frames; // received slots of the video ring, to the render thread
+	SPSCQueue< int > releasedFrames; // slots the render thread is done with, back to the I/O thread
+	int heldFrame = -1; // render thread only
+	std::atomic< unsigned int > droppedFrames{ 0 };
+	std::atomic< bool > notifyFrames{ false };
+
+	std::atomic< bool > quit{ false };
+	std::thread thread;
+};
+
+
+#endif
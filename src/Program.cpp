@@ -36,7 +36,10 @@ Program::Program()
 Program::~Program()
 {
 	if( this->id )
+	{
 		glDeleteProgram( this->id );
+		GLState::forgetProgram( this->id );
+	}
 }
 
 
@@ -47,6 +50,7 @@ void Program::create()
 	{
 		glDeleteProgram( this->id );
 		GLES2_ERROR_CHECK("glDeleteProgram");
+		GLState::forgetProgram( this->id );
 	}
 	this->id = glCreateProgram();
 	GLES2_ERROR_CHECK("glCreateProgram");
@@ -81,6 +85,7 @@ void Program::link()
 			GLES2_ERROR_CHECK("glGetProgramInfoLog");
 			std::string log( infoLog.get(), infoLen-1 );
 			glDeleteProgram( this->id );
+			GLState::forgetProgram( this->id );
 			throw RUNTIME_ERROR
 			(
 				"Error linking shader program:\n"
@@ -92,12 +97,31 @@ void Program::link()
 		else
 		{
 			glDeleteProgram( this->id );
+			GLState::forgetProgram( this->id );
 			throw RUNTIME_ERROR( "Error linking shader program! (no log generated)\n" );
 		}
 	}
 }
 
 
+void Program::build( const std::string & vertexSource, const std::string & fragmentSource, ProgramCache * cache )
+{
+	this->create();
+	if( cache )
+	{
+		if( cache->load( this->id, vertexSource, fragmentSource ) )
+			return;
+		// a rejected binary may leave the program in any state - start over
+		this->create();
+	}
+	this->attach( Shader( GL_VERTEX_SHADER, vertexSource ) );
+	this->attach( Shader( GL_FRAGMENT_SHADER, fragmentSource ) );
+	this->link();
+	if( cache )
+		cache->save( this->id, vertexSource, fragmentSource );
+}
+
+
 GLint Program::getAttributeLocation( const std::string & name, bool mandatory ) const
 {
 	GLES2_ERROR_CHECK_UNHANDLED();
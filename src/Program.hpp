@@ -23,6 +23,8 @@
 
 #include "Shader.hpp"
 #include "Error.hpp"
+#include "ProgramCache.hpp"
+#include "GLState.hpp"
 
 #include <string>
 
@@ -41,15 +43,15 @@ public:
 	void create();
 	void attach( const Shader & shader );
 	void link();
+	// create, attach and link in one go - skips compiling if the cache has a binary the driver accepts
+	void build( const std::string & vertexSource, const std::string & fragmentSource, ProgramCache * cache = nullptr );
 
 	GLint getAttributeLocation( const std::string & name, bool mandatory = true ) const;
 	GLint getUniformLocation( const std::string & name, bool mandatory = true ) const;
 
 	void use() const
 	{
-		GLES2_ERROR_CHECK_UNHANDLED();
-		glUseProgram( this->id );
-		GLES2_ERROR_CHECK("glUseProgram");
+		GLState::useProgram( this->id );
 	}
 
 private:
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ProgramCache.hpp"
+#include "Error.hpp"
+
+#include <exceptions.hpp>
+
+#include <fstream>
+#include <vector>
+#include <iterator>
+#include <cstdio>
+
+#include <sys/stat.h>
+#include <errno.h>
+
+
+// FNV-1a - only has to tell different sources apart, not to resist attacks
+static uint64_t hash( uint64_t h, const std::string & data )
+{
+	for( unsigned char c : data )
+	{
+		h ^= c;
+		h *= 0x100000001b3ull;
+	}
+	// separates the fields, so "ab"+"c" and "a"+"bc" differ
+	h ^= 0xff;
+	h *= 0x100000001b3ull;
+	return h;
+}
+
+
+static void makeDirectories( const std::string & path )
+{
+	for( size_t i = 1; i <= path.size(); i++ )
+	{
+		if( i == path.size() || path[i] == '/' )
+		{
+			if( mkdir( path.substr( 0, i ).c_str(), 0755 ) && errno != EEXIST )
+				throw SYSTEM_ERROR( errno, "Could not create \"" + path.substr( 0, i ) + "\"" );
+		}
+	}
+}
+
+
+ProgramCache::ProgramCache( const std::string & directory, PFNGLGETPROGRAMBINARYOESPROC getProgramBinary, PFNGLPROGRAMBINARYOESPROC programBinary )
+	: directory( directory ), getProgramBinary( getProgramBinary ), programBinary( programBinary )
+{
+	if( !getProgramBinary || !programBinary )
+		throw RUNTIME_ERROR( "GL_OES_get_program_binary is not available" );
+
+	GLint formats = 0;
+	glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats );
+	if( formats <= 0 )
+		throw RUNTIME_ERROR( "Driver supports no program binary formats" );
+
+	this->driver = std::string( (const char*)glGetString( GL_VENDOR ) ) + "\n" + (const char*)glGetString( GL_RENDERER ) + "\n" + (const char*)glGetString( GL_VERSION );
+	makeDirectories( this->directory );
+}
+
+
+ProgramCache::~ProgramCache()
+{
+}
+
+
+std::string ProgramCache::getFile( const std::string & vertexSource, const std::string & fragmentSource ) const
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	h = hash( h, this->driver );
+	h = hash( h, vertexSource );
+	h = hash( h, fragmentSource );
+
+	char name[32];
+	snprintf( name, sizeof(name), "%016llx.bin", (unsigned long long)h );
+	return this->directory + "/" + name;
+}
+
+
+bool ProgramCache::load( GLuint program, const std::string & vertexSource, const std::string & fragmentSource )
+{
+	std::ifstream file( this->getFile( vertexSource, fragmentSource ), std::ios::binary );
+	if( !file )
+		return false;
+
+	uint32_t format = 0;
+	if( !file.read( (char*)&format, sizeof(format) ) )
+		return false;
+	std::vector< char > binary( ( std::istreambuf_iterator< char >( file ) ), std::istreambuf_iterator< char >() );
+	if( binary.empty() )
+		return false;
+
+	GLES2_ERROR_CHECK_UNHANDLED();
+	this->programBinary( program, format, binary.data(), binary.size() );
+	// an invalid or outdated binary is reported through the link status, but some drivers raise an error as well
+	GLES2_ERROR_CLEAR();
+
+	GLint isLinked = 0;
+	glGetProgramiv( program, GL_LINK_STATUS, &isLinked );
+	if( !isLinked )
+	{
+		this->rejected++;
+		return false;
+	}
+	this->loaded++;
+	return true;
+}
+
+
+bool ProgramCache::save( GLuint program, const std::string & vertexSource, const std::string & fragmentSource )
+{
+	GLES2_ERROR_CHECK_UNHANDLED();
+	GLint length = 0;
+	glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH_OES, &length );
+	// a driver that cannot hand out the binary only costs the cache entry, see the header
+	bool failed = glGetError() != GL_NO_ERROR;
+	GLES2_ERROR_CLEAR();
+	if( failed || length <= 0 )
+		return false;
+
+	std::vector< char > binary( length );
+	GLenum format = 0;
+	this->getProgramBinary( program, length, &length, &format, binary.data() );
+	failed = glGetError() != GL_NO_ERROR;
+	GLES2_ERROR_CLEAR();
+	if( failed || length <= 0 )
+		return false;
+
+	// written to a temporary file first, so a crash never leaves a truncated binary behind
+	std::string path = this->getFile( vertexSource, fragmentSource );
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file( temporary, std::ios::binary | std::ios::trunc );
+		uint32_t format32 = format;
+		file.write( (const char*)&format32, sizeof(format32) );
+		file.write( binary.data(), length );
+		if( !file )
+		{
+			file.close();
+			remove( temporary.c_str() );
+			return false;
+		}
+	}
+	if( rename( temporary.c_str(), path.c_str() ) )
+	{
+		remove( temporary.c_str() );
+		return false;
+	}
+	this->saved++;
+	return true;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PROGRAMCACHE_INCLUDED_
+#define _PROGRAMCACHE_INCLUDED_
+
+
+#include <string>
+
+#include <stdint.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+
+/**
+ * Keeps linked program binaries on disk (GL_OES_get_program_binary).
+ *
+ * Binaries are stored under a hash of the shader sources and the driver identification
+ * (vendor, renderer and version), so a driver update never sees binaries of another driver.
+ * The driver may still reject a binary - Program then falls back to compiling and saves the
+ * new binary over the old one.
+ */
+class ProgramCache
+{
+public:
+	ProgramCache( const ProgramCache & ) = delete;
+	ProgramCache & operator=( const ProgramCache & ) = delete;
+
+	// must be constructed with the GL context current - the entry points come from the context owner
+	ProgramCache( const std::string & directory, PFNGLGETPROGRAMBINARYOESPROC getProgramBinary, PFNGLPROGRAMBINARYOESPROC programBinary );
+	virtual ~ProgramCache();
+
+	// true if program has been linked from a cached binary
+	bool load( GLuint program, const std::string & vertexSource, const std::string & fragmentSource );
+	// false if the binary could not be written - the cache is an optimisation, so that is no error
+	bool save( GLuint program, const std::string & vertexSource, const std::string & fragmentSource );
+
+	const std::string & getDirectory() const
+	{
+		return this->directory;
+	}
+
+	unsigned int getLoaded() const
+	{
+		return this->loaded;
+	}
+
+	unsigned int getRejected() const
+	{
+		return this->rejected;
+	}
+
+	unsigned int getSaved() const
+	{
+		return this->saved;
+	}
+
+private:
+	std::string getFile( const std::string & vertexSource, const std::string & fragmentSource ) const;
+
+	std::string directory;
+	std::string driver;
+	PFNGLGETPROGRAMBINARYOESPROC getProgramBinary;
+	PFNGLPROGRAMBINARYOESPROC programBinary;
+
+	unsigned int loaded = 0;
+	unsigned int rejected = 0;
+	unsigned int saved = 0;
+};
+
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Random.hpp"
+
+
+static uint64_t mix( uint64_t z )
+{
+	z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+	z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebull;
+	return z ^ ( z >> 31 );
+}
+
+
+Random::Random( uint64_t seed, uint64_t stream )
+{
+	// neighbouring streams must not produce overlapping or correlated sequences
+	this->state = mix( seed ) ^ mix( stream + 0x9e3779b97f4a7c15ull );
+}
+
+
+Random::~Random()
+{
+}
+
+
+uint32_t Random::next()
+{
+	this->state += 0x9e3779b97f4a7c15ull;
+	return mix( this->state ) >> 32;
+}
+
+
+float Random::nextFloat()
+{
+	// 24 bits fit the float mantissa exactly
+	return ( this->next() >> 8 ) * ( 1.0f / 16777215.0f );
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RANDOM_INCLUDED_
+#define _RANDOM_INCLUDED_
+
+
+#include <stdint.h>
+
+
+/**
+ * A small seeded random number generator (SplitMix64).
+ *
+ * Unlike rand() it has no hidden global state, so every fish can own a generator derived from
+ * the session seed and its index, and the outcome does not depend on the order or the thread
+ * in which the numbers are drawn.
+ */
+class Random
+{
+public:
+	Random( uint64_t seed = 1, uint64_t stream = 0 );
+	virtual ~Random();
+
+	uint32_t next();
+	// uniformly distributed in [0,1]
+	float nextFloat();
+
+private:
+	uint64_t state;
+};
+
+
+#endif
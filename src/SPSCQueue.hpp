@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPSCQUEUE_INCLUDED_
+#define _SPSCQUEUE_INCLUDED_
+
+
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <cstddef>
+
+
+/**
+ * A bounded lock-free queue between exactly one producer thread and one consumer thread.
+ *
+ * All slots are allocated up front, so push() and pop() never allocate - they move elements in
+ * and out of the slots. Each side only writes its own index, which lives on its own cache line.
+ */
+template< typename T >
+class SPSCQueue
+{
+public:
+	SPSCQueue( const SPSCQueue & ) = delete;
+	SPSCQueue & operator=( const SPSCQueue & ) = delete;
+
+	// capacity is rounded up to a power of two
+	SPSCQueue( unsigned int capacity )
+	{
+		unsigned int size = 1;
+		while( size < capacity )
+			size <<= 1;
+		this->slots.resize( size );
+		this->mask = size - 1;
+	}
+
+	virtual ~SPSCQueue()
+	{
+	}
+
+	// producer only - false if the queue is full
+	bool push( T && value )
+	{
+		unsigned int tail = this->tail.load( std::memory_order_relaxed );
+		if( tail - this->head.load( std::memory_order_acquire ) > this->mask )
+			return false;
+		this->slots[ tail & this->mask ] = std::move( value );
+		this->tail.store( tail + 1, std::memory_order_release );
+		return true;
+	}
+
+	bool push( const T & value )
+	{
+		T copy( value );
+		return this->push( std::move( copy ) );
+	}
+
+	// consumer only - false if the queue is empty
+	bool pop( T & value )
+	{
+		unsigned int head = this->head.load( std::memory_order_relaxed );
+		if( head == this->tail.load( std::memory_order_acquire ) )
+			return false;
+		value = std::move( this->slots[ head & this->mask ] );
+		this->head.store( head + 1, std::memory_order_release );
+		return true;
+	}
+
+	unsigned int getCapacity() const
+	{
+		return this->mask + 1;
+	}
+
+private:
+	static const size_t cacheLineSize = 64;
+
+	std::vector< T > slots;
+	unsigned int mask = 0;
+	// padded instead of aligned - C++11 new does not honour alignas beyond alignof(max_align_t)
+	char padding0[ cacheLineSize ];
+	std::atomic< unsigned int > head{ 0 }; // written by the consumer
+	char padding1[ cacheLineSize - sizeof(std::atomic< unsigned int >) ];
+	std::atomic< unsigned int > tail{ 0 }; // written by the producer
+	char padding2[ cacheLineSize - sizeof(std::atomic< unsigned int >) ];
+};
+
+
+#endif
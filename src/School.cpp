@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "School.hpp"
+#include "TouchGrid.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cstring>
+
+
+// GCC vector extensions - compiled to SSE on x86 and NEON on ARM
+typedef float float4 __attribute__(( vector_size(16) ));
+typedef int32_t int4 __attribute__(( vector_size(16) ));
+
+static_assert( School::lanes * sizeof(float) == sizeof(float4), "School::lanes does not match the vector size" );
+static_assert( School::chunkSize % School::lanes == 0, "School::chunkSize must be a multiple of School::lanes" );
+
+
+static inline float4 load( const float * p )
+{
+	float4 v;
+	std::memcpy( &v, p, sizeof(v) );
+	return v;
+}
+
+
+static inline int4 load( const int32_t * p )
+{
+	int4 v;
+	std::memcpy( &v, p, sizeof(v) );
+	return v;
+}
+
+
+static inline void store( float * p, float4 v )
+{
+	std::memcpy( p, &v, sizeof(v) );
+}
+
+
+static inline float4 splat( float x )
+{
+	return float4{ x, x, x, x };
+}
+
+
+static inline float4 select( int4 mask, float4 a, float4 b )
+{
+	return (float4)( ( (int4)a & mask ) | ( (int4)b & ~mask ) );
+}
+
+
+static inline float4 min( float4 a, float4 b )
+{
+	return select( a < b, a, b );
+}
+
+
+static inline float4 max( float4 a, float4 b )
+{
+	return select( a > b, a, b );
+}
+
+
+// adding and subtracting 1.5*2^23 rounds to the nearest integer - the low mantissa bits of the sum hold that integer
+static const float roundMagic = 12582912.0f;
+
+
+// x - round(x/period)*period
+static inline float4 wrap( float4 x, float period )
+{
+	float4 q = ( x * splat( 1.0f / period ) + splat( roundMagic ) ) - splat( roundMagic );
+	return x - q * splat( period );
+}
+
+
+// about 4e-6 absolute error
+static inline float4 fastSin( float4 x )
+{
+	// sin(x) = (-1)^q * sin(x - q*pi) with x - q*pi in [-pi/2,pi/2]
+	float4 shifted = x * splat( (float)M_1_PI ) + splat( roundMagic );
+	int4 odd = (int4)shifted << 31;
+	float4 q = shifted - splat( roundMagic );
+	float4 r = ( x - q * splat( 3.140625f ) ) - q * splat( (float)( M_PI - 3.140625 ) );
+	r = (float4)( (int4)r ^ odd );
+
+	float4 r2 = r * r;
+	float4 p = splat( 1.0f / 362880.0f );
+	p = p * r2 - splat( 1.0f / 5040.0f );
+	p = p * r2 + splat( 1.0f / 120.0f );
+	p = p * r2 - splat( 1.0f / 6.0f );
+	return r + r * r2 * p;
+}
+
+
+static inline float4 fastCos( float4 x )
+{
+	return fastSin( x + splat( (float)M_PI_2 ) );
+}
+
+
+// two newton iterations on the classic bit level estimate - about 5e-6 relative error
+static inline float4 fastInverseSqrt( float4 x )
+{
+	float4 y = (float4)( int4{ 0x5f3759df, 0x5f3759df, 0x5f3759df, 0x5f3759df } - ( (int4)x >> 1 ) );
+	float4 halfX = x * splat( 0.5f );
+	y = y * ( splat( 1.5f ) - halfX * y * y );
+	y = y * ( splat( 1.5f ) - halfX * y * y );
+	return y;
+}
+
+
+School::School()
+{
+}
+
+
+School::~School()
+{
+}
+
+
+void School::resize( unsigned int paddedCount )
+{
+	// padding fish sit still outside of the pond, so they never produce NaNs or denormals
+	Fish padding;
+	padding.position[0] = 2.0f;
+	padding.position[1] = 2.0f;
+	padding.agility = 0.0f;
+	padding.speed = 0.0f;
+	padding.minSpeed = 0.0f;
+	padding.maxSpeed = 0.0f;
+
+	this->positionX.resize( paddedCount, padding.position[0] );
+	this->positionY.resize( paddedCount, padding.position[1] );
+	this->rotation.resize( paddedCount, padding.rotation );
+	this->scale.resize( paddedCount, padding.scale );
+	this->phase.resize( paddedCount, padding.phase );
+	this->agility.resize( paddedCount, padding.agility );
+	this->speed.resize( paddedCount, padding.speed );
+	this->maxSpeed.resize( paddedCount, padding.maxSpeed );
+	this->minSpeed.resize( paddedCount, padding.minSpeed );
+	this->rotationSpeed.resize( paddedCount, padding.rotationSpeed );
+	this->rotationMaxSpeed.resize( paddedCount, padding.rotationMaxSpeed );
+	this->sensitivityDistance.resize( paddedCount, padding.sensitivityDistance );
+	this->targetX.resize( paddedCount, 0.0f );
+	this->targetY.resize( paddedCount, 0.0f );
+	this->hasTarget.resize( paddedCount, 0 );
+}
+
+
+void School::add( const Fish & fish )
+{
+	unsigned int i = this->count++;
+	if( this->count > this->positionX.size() )
+		this->resize( ( this->count + lanes - 1 ) / lanes * lanes );
+
+	this->positionX[i] = fish.position[0];
+	this->positionY[i] = fish.position[1];
+	this->rotation[i] = fish.rotation;
+	this->scale[i] = fish.scale;
+	this->phase[i] = fish.phase;
+	this->agility[i] = fish.agility;
+	this->speed[i] = fish.speed;
+	this->maxSpeed[i] = fish.maxSpeed;
+	this->minSpeed[i] = fish.minSpeed;
+	this->rotationSpeed[i] = fish.rotationSpeed;
+	this->rotationMaxSpeed[i] = fish.rotationMaxSpeed;
+	this->sensitivityDistance[i] = fish.sensitivityDistance;
+}
+
+
+Fish School::get( unsigned int i ) const
+{
+	Fish fish;
+	fish.position[0] = this->positionX[i];
+	fish.position[1] = this->positionY[i];
+	fish.rotation = this->rotation[i];
+	fish.scale = this->scale[i];
+	fish.phase = this->phase[i];
+	fish.agility = this->agility[i];
+	fish.speed = this->speed[i];
+	fish.maxSpeed = this->maxSpeed[i];
+	fish.minSpeed = this->minSpeed[i];
+	fish.rotationSpeed = this->rotationSpeed[i];
+	fish.rotationMaxSpeed = this->rotationMaxSpeed[i];
+	fish.sensitivityDistance = this->sensitivityDistance[i];
+	return fish;
+}
+
+
+void School::clear()
+{
+	this->count = 0;
+	this->resize( 0 );
+}
+
+
+void School::update( const TouchGrid & touchGrid, ThreadPool * threadPool )
+{
+	if( threadPool )
+	{
+		threadPool->run( this->getChunkCount(), [&]( unsigned int chunk )
+		{
+			this->updateChunk( touchGrid, chunk );
+		} );
+	}
+	else
+	{
+		for( unsigned int chunk = 0; chunk < this->getChunkCount(); chunk++ )
+			this->updateChunk( touchGrid, chunk );
+	}
+}
+
+
+void School::updateChunk( const TouchGrid & touchGrid, unsigned int chunk )
+{
+	unsigned int begin = chunk * chunkSize;
+	unsigned int end = std::min( begin + chunkSize, (unsigned int)this->positionX.size() );
+
+	// nearest touch lookup does not vectorize - do it up front
+	for( unsigned int i = begin; i < end; i++ )
+	{
+		// sensitivityDistance is compared against squared distances
+		const Touch * nearest = touchGrid.empty() ? nullptr : touchGrid.findNearest( this->positionX[i], this->positionY[i], this->sensitivityDistance[i] );
+		this->hasTarget[i] = nearest ? -1 : 0;
+		this->targetX[i] = nearest ? nearest->point[0] : this->positionX[i] + 1.0f;
+		this->targetY[i] = nearest ? nearest->point[1] : this->positionY[i];
+	}
+
+	for( unsigned int i = begin; i < end; i += lanes )
+	{
+		float4 positionX = load( &this->positionX[i] );
+		float4 positionY = load( &this->positionY[i] );
+		float4 rotation = load( &this->rotation[i] );
+		float4 scale = load( &this->scale[i] );
+		float4 phase = load( &this->phase[i] );
+		float4 agility = load( &this->agility[i] );
+		float4 speed = load( &this->speed[i] );
+		float4 maxSpeed = load( &this->maxSpeed[i] );
+		float4 minSpeed = load( &this->minSpeed[i] );
+		float4 rotationSpeed = load( &this->rotationSpeed[i] );
+		float4 rotationMaxSpeed = load( &this->rotationMaxSpeed[i] );
+		int4 hasTarget = load( &this->hasTarget[i] );
+
+		float4 sin = fastSin( rotation );
+		float4 cos = fastCos( rotation );
+		// perp = (cos,sin), head = perp rotated by 90 degrees = (-sin,cos)
+
+		// steer towards the touch
+		float4 toTouchX = load( &this->targetX[i] ) - positionX;
+		float4 toTouchY = load( &this->targetY[i] ) - positionY;
+		float4 toTouchLength = fastInverseSqrt( toTouchX*toTouchX + toTouchY*toTouchY );
+		float4 dotTouch = cos * ( toTouchX * toTouchLength ) + sin * ( toTouchY * toTouchLength );
+		float4 speedTouch = speed + agility * ( maxSpeed - speed );
+		float4 rotationSpeedTouch = rotationSpeed - agility * dotTouch;
+
+		// or slowly drift back to the center
+		float4 toCenterLength = fastInverseSqrt( positionX*positionX + positionY*positionY );
+		float4 dotCenter = cos * ( -positionX * toCenterLength ) + sin * ( -positionY * toCenterLength );
+		float4 speedIdle = speed - agility * ( speed - minSpeed );
+		float4 rotationSpeedIdle = rotationSpeed - splat( 0.1f ) * agility * dotCenter;
+
+		speed = select( hasTarget, speedTouch, speedIdle );
+		rotationSpeed = select( hasTarget, rotationSpeedTouch, rotationSpeedIdle );
+		rotationSpeed = max( min( rotationSpeed, rotationMaxSpeed ), -rotationMaxSpeed );
+
+		phase += splat( 5.0f ) * ( speed / scale );
+		positionX -= sin * speed;
+		positionY += cos * speed;
+		// keeps the range reduction of fastSin accurate - rotations are only ever used through sin and cos
+		rotation = wrap( rotation + rotationSpeed, 2.0f * (float)M_PI );
+		rotationSpeed -= splat( 10.0f ) * agility * rotationSpeed;
+
+		store( &this->positionX[i], positionX );
+		store( &this->positionY[i], positionY );
+		store( &this->rotation[i], rotation );
+		store( &this->phase[i], phase );
+		store( &this->speed[i], speed );
+		store( &this->rotationSpeed[i], rotationSpeed );
+	}
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCHOOL_INCLUDED_
+#define _SCHOOL_INCLUDED_
+
+
+#include <vector>
+
+#include <stdint.h>
+
+
+class TouchGrid;
+class ThreadPool;
+
+
+struct Fish
+{
+	float position[2] = { 0.0f, 0.0f };
+	float rotation = 0.0f;
+	float scale = 0.075f;
+	float phase = 0.0f;
+	float agility = 0.004f;
+	float speed = 0.0006f;
+	float maxSpeed = 0.005f;
+	float minSpeed = 0.0005f;
+	float rotationSpeed = 0.0f;
+	float rotationMaxSpeed = 0.1f;
+	float sensitivityDistance = 0.5f;
+};
+
+
+/**
+ * All fish of the pond stored as a structure of arrays.
+ *
+ * The arrays are padded to a multiple of School::lanes, so update() can process whole SIMD
+ * vectors without a scalar tail. Padding fish are simulated as well but never reported by size().
+ *
+ * update() works on independent chunks of School::chunkSize fish. Every fish only reads its own
+ * state and the touch grid, so the result is the same for any number of threads.
+ */
+class School
+{
+public:
+	static const unsigned int lanes = 4;
+	static const unsigned int chunkSize = 256;
+
+	School( const School & ) = delete;
+	School & operator=( const School & ) = delete;
+
+	School();
+	virtual ~School();
+
+	void add( const Fish & fish );
+	Fish get( unsigned int index ) const;
+	void clear();
+
+	// runs the chunks on threadPool if given - which must not be busy with another job
+	void update( const TouchGrid & touchGrid, ThreadPool * threadPool = nullptr );
+	// for overlapping the update with other work by starting the chunks on a thread pool directly
+	void updateChunk( const TouchGrid & touchGrid, unsigned int chunk );
+
+	unsigned int getChunkCount() const
+	{
+		return ( this->positionX.size() + chunkSize - 1 ) / chunkSize;
+	}
+
+	unsigned int size() const
+	{
+		return this->count;
+	}
+
+	bool empty() const
+	{
+		return !this->count;
+	}
+
+	const float * getPositionX() const
+	{
+		return this->positionX.data();
+	}
+
+	const float * getPositionY() const
+	{
+		return this->positionY.data();
+	}
+
+	const float * getRotation() const
+	{
+		return this->rotation.data();
+	}
+
+	const float * getScale() const
+	{
+		return this->scale.data();
+	}
+
+	const float * getPhase() const
+	{
+		return this->phase.data();
+	}
+
+private:
+	void resize( unsigned int paddedCount );
+
+	unsigned int count = 0;
+
+	std::vector< float > positionX;
+	std::vector< float > positionY;
+	std::vector< float > rotation;
+	std::vector< float > scale;
+	std::vector< float > phase;
+	std::vector< float > agility;
+	std::vector< float > speed;
+	std::vector< float > maxSpeed;
+	std::vector< float > minSpeed;
+	std::vector< float > rotationSpeed;
+	std::vector< float > rotationMaxSpeed;
+	std::vector< float > sensitivityDistance;
+
+	// position of the touch each fish swims to - written by the scalar lookup pass
+	std::vector< float > targetX;
+	std::vector< float > targetY;
+	std::vector< int32_t > hasTarget; // all bits set if there is a target
+};
+
+
+#endif
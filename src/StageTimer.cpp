@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StageTimer.hpp"
+
+#include <iomanip>
+#include <algorithm>
+
+
+StageTimer::StageTimer()
+{
+	this->mark();
+}
+
+
+StageTimer::~StageTimer()
+{
+}
+
+
+unsigned int StageTimer::addStage( const std::string & name )
+{
+	Stage stage;
+	stage.name = name;
+	this->stages.push_back( stage );
+	return this->stages.size() - 1;
+}
+
+
+double StageTimer::getSeconds() const
+{
+	double seconds = 0.0;
+	for( const auto & stage : this->stages )
+		seconds += stage.seconds;
+	return seconds;
+}
+
+
+void StageTimer::report( std::ostream & out ) const
+{
+	double seconds = this->getSeconds();
+	unsigned long frames = this->frames ? this->frames : 1;
+
+	size_t nameWidth = 0;
+	for( const auto & stage : this->stages )
+		nameWidth = std::max( nameWidth, stage.name.size() );
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << std::fixed << std::setprecision( 3 );
+	out << "Frames      : " << this->frames << "\n";
+	out << "Time        : " << seconds << "s\n";
+	out << "Frame rate  : " << ( seconds > 0.0 ? this->frames / seconds : 0.0 ) << "fps\n";
+	out << "Stages (average per frame):\n";
+	for( const auto & stage : this->stages )
+	{
+		out << "  " << std::left << std::setw( nameWidth ) << stage.name << std::right << " : "
+		    << std::setw( 9 ) << ( stage.seconds * 1000.0 / frames ) << "ms ("
+		    << std::setw( 6 ) << std::setprecision( 2 ) << ( seconds > 0.0 ? stage.seconds * 100.0 / seconds : 0.0 ) << "%)\n"
+		    << std::setprecision( 3 );
+	}
+
+	out.flags( flags );
+	out.precision( precision );
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _STAGETIMER_INCLUDED_
+#define _STAGETIMER_INCLUDED_
+
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <chrono>
+
+
+/**
+ * Accumulates wall clock time of consecutive stages of a frame.
+ *
+ * The time between two calls to lap() (or between mark() and the first lap()) is
+ * attributed to the given stage, so stages are expected to follow each other without gaps.
+ */
+class StageTimer
+{
+public:
+	StageTimer( const StageTimer & ) = delete;
+	StageTimer & operator=( const StageTimer & ) = delete;
+
+	StageTimer();
+	virtual ~StageTimer();
+
+	unsigned int addStage( const std::string & name );
+
+	void mark()
+	{
+		this->last = Clock::now();
+	}
+
+	void lap( unsigned int stage )
+	{
+		Clock::time_point now = Clock::now();
+		this->stages[stage].seconds += std::chrono::duration< double >( now - this->last ).count();
+		this->last = now;
+	}
+
+	void nextFrame()
+	{
+		this->frames++;
+	}
+
+	unsigned long getFrames() const
+	{
+		return this->frames;
+	}
+
+	double getSeconds() const;
+
+	void report( std::ostream & out ) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Stage
+	{
+		std::string name;
+		double seconds = 0.0;
+	};
+
+	std::vector< Stage > stages;
+	Clock::time_point last;
+	unsigned long frames = 0;
+};
+
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StreamingTexture.hpp"
+
+
+StreamingTexture::StreamingTexture( GLenum format, GLint minFilter, GLint magFilter )
+	: format( format ), minFilter( minFilter ), magFilter( magFilter )
+{
+	switch( format )
+	{
+	case GL_ALPHA:
+	case GL_LUMINANCE:
+		this->bytesPerPixel = 1;
+		break;
+	case GL_LUMINANCE_ALPHA:
+		this->bytesPerPixel = 2;
+		break;
+	case GL_RGB:
+		this->bytesPerPixel = 3;
+		break;
+	default:
+		this->bytesPerPixel = 4;
+		break;
+	}
+}
+
+
+StreamingTexture::~StreamingTexture()
+{
+}
+
+
+void StreamingTexture::upload( const void * pixels, unsigned int width, unsigned int height )
+{
+	// the texture that was not drawn from last
+	unsigned int next = this->uploads ? this->current ^ 1 : this->current;
+	std::unique_ptr< Texture2D > & texture = this->textures[next];
+	if( !texture || texture->getWidth() != width || texture->getHeight() != height )
+		texture.reset( new Texture2D( width, height, this->format, this->minFilter, this->magFilter, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE ) );
+
+	// rows of e.g. odd width luminance images are not 4 byte aligned
+	bool aligned = !( width * this->bytesPerPixel % 4 );
+	if( !aligned )
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	texture->upload( pixels, this->format, GL_UNSIGNED_BYTE );
+	if( !aligned )
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+	this->current = next;
+	this->uploads++;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _STREAMINGTEXTURE_INCLUDED_
+#define _STREAMINGTEXTURE_INCLUDED_
+
+
+#include "Texture2D.hpp"
+
+#include <memory>
+
+#include <GLES2/gl2.h>
+
+
+/**
+ * A texture that receives a new image every few frames, e.g. from a camera.
+ *
+ * Uploads alternate between two textures, so glTexSubImage2D never writes the texture the GPU
+ * may still be reading for the previous frame - GLES2 has no pixel buffer objects to decouple
+ * them otherwise. The textures are only reallocated when the size of the images changes.
+ */
+class StreamingTexture
+{
+public:
+	StreamingTexture( const StreamingTexture & ) = delete;
+	StreamingTexture & operator=( const StreamingTexture & ) = delete;
+
+	// format is e.g. GL_LUMINANCE or GL_RGBA - the pixels are unsigned bytes
+	StreamingTexture( GLenum format, GLint minFilter = GL_LINEAR, GLint magFilter = GL_LINEAR );
+	virtual ~StreamingTexture();
+
+	void upload( const void * pixels, unsigned int width, unsigned int height );
+
+	// the latest image, nullptr before the first upload
+	const Texture2D * getTexture() const
+	{
+		return this->textures[ this->current ].get();
+	}
+
+	unsigned long getUploads() const
+	{
+		return this->uploads;
+	}
+
+private:
+	GLenum format;
+	GLint minFilter;
+	GLint magFilter;
+	unsigned int bytesPerPixel;
+	std::unique_ptr< Texture2D > textures[2];
+	unsigned int current = 0;
+	unsigned long uploads = 0;
+};
+
+
+#endif
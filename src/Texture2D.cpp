@@ -19,23 +19,24 @@
 
 #include "Texture2D.hpp"
 #include "Error.hpp"
+#include "ETC.hpp"
 
 #include <exceptions.hpp>
 
-#include <stdlib.h>
+#include <vector>
+#include <algorithm>
 
-#include <IL/il.h>
+#include <stdlib.h>
 
 
-Texture2D::Texture2D( unsigned int width, unsigned int height, GLint internalFormat, GLint minFilter, GLint maxFilter, GLint wrapS, GLint wrapT )
+Texture2D::Texture2D( unsigned int width, unsigned int height, GLint internalFormat, GLint minFilter, GLint maxFilter, GLint wrapS, GLint wrapT, GLenum type )
 {
 	GLES2_ERROR_CHECK_UNHANDLED();
 
 	glGenTextures( 1, &this->id );
 	GLES2_ERROR_CHECK("glGenTextures");
 
-	glBindTexture( GL_TEXTURE_2D, this->id );
-	GLES2_ERROR_CHECK("glBindTexture");
+	GLState::bindTexture( this->id );
 
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter );
 	GLES2_ERROR_CHECK("glTexParameteri");
@@ -47,7 +48,8 @@ Texture2D::Texture2D( unsigned int width, unsigned int height, GLint internalFor
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT );
 	GLES2_ERROR_CHECK("glTexParameteri");
 
-	glTexImage2D( GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0 );
+	// GLES2 needs the format to match the internal format
+	glTexImage2D( GL_TEXTURE_2D, 0, internalFormat, width, height, 0, internalFormat, type, 0 );
 	GLES2_ERROR_CHECK("glTexImage2D");
 
 	this->width = width;
@@ -55,21 +57,14 @@ Texture2D::Texture2D( unsigned int width, unsigned int height, GLint internalFor
 }
 
 
-Texture2D::Texture2D( const std::string & file, GLint minFilter, GLint maxFilter, GLint wrapS, GLint wrapT )
+Texture2D::Texture2D( const Image & image, GLint minFilter, GLint maxFilter, GLint wrapS, GLint wrapT )
 {
 	GLES2_ERROR_CHECK_UNHANDLED();
 
-	ILuint image;
-	ilGenImages( 1, &image );
-	ilBindImage( image );
-	if( !ilLoadImage( file.c_str() ) )
-		throw RUNTIME_ERROR( "Could not load \"" + file + "\"!" );
-
 	glGenTextures( 1, &this->id );
 	GLES2_ERROR_CHECK("glGenTextures");
 
-	glBindTexture( GL_TEXTURE_2D, this->id );
-	GLES2_ERROR_CHECK("glBindTexture");
+	GLState::bindTexture( this->id );
 
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter );
 	GLES2_ERROR_CHECK("glTexParameteri");
@@ -81,17 +76,104 @@ Texture2D::Texture2D( const std::string & file, GLint minFilter, GLint maxFilter
 	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT );
 	GLES2_ERROR_CHECK("glTexParameteri");
 
-	glTexImage2D( GL_TEXTURE_2D, 0, ilGetInteger( IL_IMAGE_FORMAT ), ilGetInteger( IL_IMAGE_WIDTH ), ilGetInteger( IL_IMAGE_HEIGHT ), 0, ilGetInteger( IL_IMAGE_FORMAT ), ilGetInteger( IL_IMAGE_TYPE ), (void*)ilGetData() );
+	this->width = image.getWidth();
+	this->height = image.getHeight();
+
+	if( image.isCompressed() )
+	{
+		this->uploadCompressed( image, minFilter != GL_NEAREST && minFilter != GL_LINEAR );
+		return;
+	}
+
+	// the rows of an Image are tightly packed
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	glTexImage2D( GL_TEXTURE_2D, 0, image.getFormat(), image.getWidth(), image.getHeight(), 0, image.getFormat(), image.getType(), image.getData() );
 	GLES2_ERROR_CHECK("glTexImage2D");
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+	if( minFilter != GL_NEAREST && minFilter != GL_LINEAR )
+	{
+		glGenerateMipmap( GL_TEXTURE_2D );
+		GLES2_ERROR_CHECK("glGenerateMipmap");
+	}
+}
+
+
+bool Texture2D::isCompressedFormatSupported( GLenum format )
+{
+	// there is only one context - the formats do not change
+	static std::vector< GLint > formats;
+	static bool queried = false;
+	if( !queried )
+	{
+		GLint count = 0;
+		glGetIntegerv( GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count );
+		formats.resize( count );
+		if( count )
+			glGetIntegerv( GL_COMPRESSED_TEXTURE_FORMATS, formats.data() );
+		GLES2_ERROR_CHECK("glGetIntegerv");
+		queried = true;
+	}
+	return std::find( formats.begin(), formats.end(), (GLint)format ) != formats.end();
+}
+
+
+void Texture2D::uploadCompressed( const Image & image, bool mipmaps )
+{
+	// without levels of its own a compressed texture cannot mipmap, because glGenerateMipmap does not support them -
+	// and an incomplete chain would make the texture incomplete
+	unsigned int chain = 1;
+	while( ( std::max( image.getWidth(), image.getHeight() ) >> chain ) > 0 )
+		chain++;
+	unsigned int levels = mipmaps && image.getLevels() >= chain ? chain : 1;
+	if( mipmaps && levels == 1 && isCompressedFormatSupported( image.getFormat() ) )
+	{
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		GLES2_ERROR_CHECK("glTexParameteri");
+	}
+
+	if( isCompressedFormatSupported( image.getFormat() ) )
+	{
+		for( unsigned int level = 0; level < levels; level++ )
+		{
+			glCompressedTexImage2D( GL_TEXTURE_2D, level, image.getFormat(), image.getWidth( level ), image.getHeight( level ), 0, image.getSize( level ), image.getData( level ) );
+			GLES2_ERROR_CHECK("glCompressedTexImage2D");
+		}
+		return;
+	}
+
+	// fallback for drivers without the extension - costs the memory and bandwidth of an uncompressed texture
+	if( !ETC::isFormat( image.getFormat() ) )
+		throw RUNTIME_ERROR( "Compressed texture format of \"" + image.getFile() + "\" is neither supported by the driver nor decodable" );
+	std::vector< uint8_t > rgba;
+	for( unsigned int level = 0; level < levels; level++ )
+	{
+		rgba.resize( 4 * image.getWidth( level ) * image.getHeight( level ) );
+		ETC::decode( image.getFormat(), image.getData( level ), image.getWidth( level ), image.getHeight( level ), rgba.data() );
+		glTexImage2D( GL_TEXTURE_2D, level, GL_RGBA, image.getWidth( level ), image.getHeight( level ), 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data() );
+		GLES2_ERROR_CHECK("glTexImage2D");
+	}
+	if( mipmaps && levels == 1 )
+	{
+		glGenerateMipmap( GL_TEXTURE_2D );
+		GLES2_ERROR_CHECK("glGenerateMipmap");
+	}
+}
+
+
+void Texture2D::upload( const void * pixels, GLenum format, GLenum type )
+{
+	GLES2_ERROR_CHECK_UNHANDLED();
 
-	this->width = ilGetInteger( IL_IMAGE_WIDTH );
-	this->height = ilGetInteger( IL_IMAGE_HEIGHT );
+	GLState::bindTexture( this->id );
 
-	ilDeleteImages( 1, &image );
+	glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, this->width, this->height, format, type, pixels );
+	GLES2_ERROR_CHECK("glTexSubImage2D");
 }
 
 
 Texture2D::~Texture2D()
 {
 	glDeleteTextures( 1, &this->id );
+	GLState::forgetTexture( this->id );
 }
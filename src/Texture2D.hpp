@@ -22,8 +22,8 @@
 
 
 #include "Error.hpp"
-
-#include <string>
+#include "Image.hpp"
+#include "GLState.hpp"
 
 #include <GLES2/gl2.h>
 
@@ -34,32 +34,38 @@ public:
 	Texture2D( const Texture2D & ) = delete;
 	Texture2D & operator=( const Texture2D & ) = delete;
 
-	Texture2D( unsigned int width, unsigned int height, GLint internalFormat, GLint minFilter, GLint maxFilter, GLint wrapS, GLint wrapT );
+	// type is GL_UNSIGNED_BYTE or e.g. GL_HALF_FLOAT_OES if the driver supports it
+	Texture2D( unsigned int width, unsigned int height, GLint internalFormat, GLint minFilter, GLint maxFilter, GLint wrapS, GLint wrapT, GLenum type = GL_UNSIGNED_BYTE );
 	Texture2D( unsigned int width, unsigned int height, GLint internalFormat )
 		: Texture2D( width, height, internalFormat, GL_NEAREST, GL_LINEAR, GL_REPEAT, GL_REPEAT )
 	{}
 
-	Texture2D( const std::string & file, GLint minFilter, GLint maxFilter, GLint wrapS, GLint wrapT );
-	Texture2D( const std::string & file )
-		: Texture2D( file, GL_NEAREST, GL_LINEAR, GL_REPEAT, GL_REPEAT )
+	// a mipmapping minFilter generates the mipmaps - GLES2 only supports that for power of two sizes.
+	// Compressed images use their own levels instead, and are decoded if the driver does not support their format.
+	Texture2D( const Image & image, GLint minFilter, GLint maxFilter, GLint wrapS, GLint wrapT );
+	Texture2D( const Image & image )
+		: Texture2D( image, GL_NEAREST, GL_LINEAR, GL_REPEAT, GL_REPEAT )
 	{}
 
 	virtual ~Texture2D();
 
+	static bool canMipmap( unsigned int width, unsigned int height )
+	{
+		return width && height && !( width & ( width - 1 ) ) && !( height & ( height - 1 ) );
+	}
+
+	static bool isCompressedFormatSupported( GLenum format );
+
+	void upload( const void * pixels, GLenum format = GL_RGBA, GLenum type = GL_UNSIGNED_BYTE );
+
 	void bind() const
 	{
-		GLES2_ERROR_CHECK_UNHANDLED();
-		glBindTexture( GL_TEXTURE_2D, this->id );
-		GLES2_ERROR_CHECK("glBindTexture");
+		GLState::bindTexture( this->id );
 	}
 
 	void bind( unsigned int unit ) const
 	{
-		GLES2_ERROR_CHECK_UNHANDLED();
-		glActiveTexture( GL_TEXTURE0 + unit );
-		GLES2_ERROR_CHECK("glActiveTexture");
-		glBindTexture( GL_TEXTURE_2D, this->id );
-		GLES2_ERROR_CHECK("glBindTexture");
+		GLState::bindTexture( unit, this->id );
 	}
 
 	const GLuint & getID() const
@@ -78,6 +84,8 @@ public:
 	}
 
 private:
+	void uploadCompressed( const Image & image, bool mipmaps );
+
 	GLuint id = 0;
 	unsigned int width = 0;
 	unsigned int height = 0;
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadPool.hpp"
+
+
+ThreadPool::ThreadPool( unsigned int threads )
+	: remaining( 0 ), active( 0 )
+{
+	if( !threads )
+		threads = std::thread::hardware_concurrency();
+	if( !threads )
+		threads = 1;
+
+	this->queues.reset( new Queue[threads] );
+	// queue 0 belongs to the thread calling wait()
+	for( unsigned int i = 1; i < threads; i++ )
+		this->workers.push_back( std::thread( &ThreadPool::workerMain, this, i ) );
+}
+
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard< std::mutex > lock( this->mutex );
+		this->quit = true;
+	}
+	this->wakeCondition.notify_all();
+	for( auto & worker : this->workers )
+		worker.join();
+}
+
+
+void ThreadPool::start( unsigned int count, const std::function< void( unsigned int ) > & task )
+{
+	unsigned int threads = this->getThreadCount();
+	{
+		std::lock_guard< std::mutex > lock( this->mutex );
+		this->task = task;
+		for( unsigned int i = 0; i < threads; i++ )
+		{
+			std::lock_guard< std::mutex > queueLock( this->queues[i].mutex );
+			this->queues[i].begin = (unsigned long)count * i / threads;
+			this->queues[i].end = (unsigned long)count * (i+1) / threads;
+		}
+		this->remaining = count;
+		this->generation++;
+	}
+	this->wakeCondition.notify_all();
+}
+
+
+void ThreadPool::wait()
+{
+	this->work( 0 );
+
+	// workers may still be looking for something to steal - the job (and the task) must outlive them
+	std::unique_lock< std::mutex > lock( this->mutex );
+	this->doneCondition.wait( lock, [this]{ return !this->remaining && !this->active; } );
+}
+
+
+void ThreadPool::work( unsigned int queue )
+{
+	unsigned int index;
+	while( this->take( queue, index ) || this->steal( queue, index ) )
+	{
+		this->task( index );
+		if( --this->remaining == 0 )
+		{
+			std::lock_guard< std::mutex > lock( this->mutex );
+			this->doneCondition.notify_all();
+		}
+	}
+}
+
+
+bool ThreadPool::take( unsigned int queue, unsigned int & index )
+{
+	Queue & q = this->queues[queue];
+	std::lock_guard< std::mutex > lock( q.mutex );
+	if( q.begin == q.end )
+		return false;
+	index = q.begin++;
+	return true;
+}
+
+
+bool ThreadPool::steal( unsigned int queue, unsigned int & index )
+{
+	unsigned int threads = this->getThreadCount();
+	for( unsigned int i = 1; i < threads; i++ )
+	{
+		Queue & q = this->queues[ (queue + i) % threads ];
+		std::lock_guard< std::mutex > lock( q.mutex );
+		if( q.begin != q.end )
+		{
+			index = --q.end;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void ThreadPool::workerMain( unsigned int queue )
+{
+	unsigned long generation = 0;
+	for(;;)
+	{
+		{
+			std::unique_lock< std::mutex > lock( this->mutex );
+			this->wakeCondition.wait( lock, [&]{ return this->quit || this->generation != generation; } );
+			if( this->quit )
+				return;
+			generation = this->generation;
+			this->active++;
+		}
+
+		this->work( queue );
+
+		{
+			std::lock_guard< std::mutex > lock( this->mutex );
+			this->active--;
+		}
+		this->doneCondition.notify_all();
+	}
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THREADPOOL_INCLUDED_
+#define _THREADPOOL_INCLUDED_
+
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+
+/**
+ * A persistent set of worker threads that execute one indexed job at a time.
+ *
+ * The indices of a job are split into one contiguous range per thread. Every thread works
+ * through its own range from the front and steals from the back of the others' ranges once
+ * its own range is empty. The thread waiting for a job helps executing it.
+ */
+class ThreadPool
+{
+public:
+	ThreadPool( const ThreadPool & ) = delete;
+	ThreadPool & operator=( const ThreadPool & ) = delete;
+
+	// threads includes the calling thread - 0 uses one thread per core
+	ThreadPool( unsigned int threads = 0 );
+	virtual ~ThreadPool();
+
+	// starts calling task(i) for every i in [0,count) - only one job may be running at a time
+	void start( unsigned int count, const std::function< void( unsigned int ) > & task );
+	// helps executing the current job and returns when it is done
+	void wait();
+
+	void run( unsigned int count, const std::function< void( unsigned int ) > & task )
+	{
+		this->start( count, task );
+		this->wait();
+	}
+
+	unsigned int getThreadCount() const
+	{
+		return this->workers.size() + 1;
+	}
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		unsigned int begin = 0;
+		unsigned int end = 0;
+	};
+
+	void work( unsigned int queue );
+	bool take( unsigned int queue, unsigned int & index );
+	bool steal( unsigned int queue, unsigned int & index );
+	void workerMain( unsigned int queue );
+
+	std::vector< std::thread > workers;
+	std::unique_ptr< Queue[] > queues;
+
+	std::function< void( unsigned int ) > task;
+	std::atomic< unsigned int > remaining;
+	std::atomic< unsigned int > active;
+
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+	unsigned long generation = 0;
+	bool quit = false;
+};
+
+
+#endif
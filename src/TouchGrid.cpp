@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TouchGrid.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+
+TouchGrid::TouchGrid( unsigned int maxResolution )
+	: maxResolution( std::max( 1u, maxResolution ) )
+{
+}
+
+
+TouchGrid::~TouchGrid()
+{
+}
+
+
+int TouchGrid::getCell( float coordinate ) const
+{
+	int cell = (int)std::floor( ( coordinate + 1.0f ) / this->cellSize );
+	return std::max( 0, std::min( (int)this->resolution - 1, cell ) );
+}
+
+
+void TouchGrid::rebuild( const std::map< int64_t, Touch > & touches )
+{
+	// about one touch per cell
+	this->resolution = std::min( this->maxResolution, std::max( 1u, (unsigned int)std::ceil( std::sqrt( (float)touches.size() ) ) ) );
+	this->cellSize = 2.0f / this->resolution;
+
+	unsigned int cells = this->resolution * this->resolution;
+	this->cellBegin.assign( cells + 1, 0 );
+	this->cellOfTouch.clear();
+	for( const auto & t : touches )
+	{
+		unsigned int cell = this->getCell( t.second.point[1] ) * this->resolution + this->getCell( t.second.point[0] );
+		this->cellOfTouch.push_back( cell );
+		this->cellBegin[ cell + 1 ]++;
+	}
+	for( unsigned int i = 0; i < cells; i++ )
+		this->cellBegin[ i + 1 ] += this->cellBegin[i];
+
+	this->entries.resize( touches.size() );
+	std::vector< unsigned int > next( this->cellBegin.begin(), this->cellBegin.end() - 1 );
+	unsigned int order = 0;
+	for( const auto & t : touches )
+	{
+		Entry & entry = this->entries[ next[ this->cellOfTouch[order] ]++ ];
+		entry.point[0] = t.second.point[0];
+		entry.point[1] = t.second.point[1];
+		entry.order = order++;
+		entry.touch = &t.second;
+	}
+}
+
+
+const Touch * TouchGrid::findNearest( float x, float y, float maxDistanceSquared ) const
+{
+	if( this->entries.empty() )
+		return nullptr;
+
+	const int cx = this->getCell( x );
+	const int cy = this->getCell( y );
+	const int res = this->resolution;
+	const int maxRing = std::min( res, (int)std::ceil( std::sqrt( maxDistanceSquared ) / this->cellSize ) + 1 );
+
+	float nearestDistance = std::numeric_limits< float >::max();
+	const Entry * nearest = nullptr;
+	for( int ring = 0; ring <= maxRing; ring++ )
+	{
+		// every point in a cell of this ring is at least (ring-1) cells away
+		if( ring > 1 )
+		{
+			float bound = ( ring - 1 ) * this->cellSize;
+			if( bound * bound >= std::min( nearestDistance, maxDistanceSquared ) )
+				break;
+		}
+
+		int yBegin = std::max( 0, cy - ring ), yEnd = std::min( res - 1, cy + ring );
+		int xBegin = std::max( 0, cx - ring ), xEnd = std::min( res - 1, cx + ring );
+		for( int gy = yBegin; gy <= yEnd; gy++ )
+		{
+			bool edgeRow = ( gy == cy - ring || gy == cy + ring );
+			// only visit the border of the ring - the inside was visited before
+			int step = edgeRow ? 1 : std::max( 1, 2 * ring );
+			for( int gx = cx - ring; gx <= cx + ring; gx += step )
+			{
+				if( gx < xBegin || gx > xEnd )
+					continue;
+				unsigned int cell = gy * res + gx;
+				for( unsigned int i = this->cellBegin[cell]; i < this->cellBegin[cell+1]; i++ )
+				{
+					const Entry & e = this->entries[i];
+					// same arithmetic as the linear scan in update_fish, so the results match exactly
+					float dx = e.point[0] - x;
+					float dy = e.point[1] - y;
+					float distance = dx*dx + dy*dy;
+					if( distance < maxDistanceSquared && ( distance < nearestDistance || ( distance == nearestDistance && nearest && e.order < nearest->order ) ) )
+					{
+						nearestDistance = distance;
+						nearest = &e;
+					}
+				}
+			}
+		}
+	}
+
+	return nearest ? nearest->touch : nullptr;
+}
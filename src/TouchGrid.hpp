@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TOUCHGRID_INCLUDED_
+#define _TOUCHGRID_INCLUDED_
+
+
+#include "Touch.hpp"
+
+#include <map>
+#include <vector>
+
+#include <stdint.h>
+
+
+/**
+ * Uniform grid over the normalized pond space [-1,1]x[-1,1] for nearest touch queries.
+ *
+ * Touches outside the pond are put into the nearest border cell. Cells are searched in rings
+ * around the queried point, stopping as soon as no closer touch can be found in the next ring.
+ * Ties are resolved like a linear scan over the touches map would: the first touch wins.
+ */
+class TouchGrid
+{
+public:
+	TouchGrid( const TouchGrid & ) = delete;
+	TouchGrid & operator=( const TouchGrid & ) = delete;
+
+	TouchGrid( unsigned int maxResolution = 32 );
+	virtual ~TouchGrid();
+
+	void rebuild( const std::map< int64_t, Touch > & touches );
+
+	// returns the nearest touch with a squared distance below maxDistanceSquared
+	const Touch * findNearest( float x, float y, float maxDistanceSquared ) const;
+
+	bool empty() const
+	{
+		return this->entries.empty();
+	}
+
+private:
+	struct Entry
+	{
+		float point[2];
+		unsigned int order;
+		const Touch * touch;
+	};
+
+	int getCell( float coordinate ) const;
+
+	unsigned int maxResolution;
+	unsigned int resolution = 1;
+	float cellSize = 2.0f;
+	std::vector< unsigned int > cellBegin; // entries of cell i are [cellBegin[i],cellBegin[i+1])
+	std::vector< Entry > entries;
+	std::vector< unsigned int > cellOfTouch;
+};
+
+
+#endif
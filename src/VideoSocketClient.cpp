@@ -23,15 +23,19 @@
 #ifndef __unix__
 //TODO: implement for non unix platforms
 using namespace PointIR;
-VideoSocketClient::VideoSocketClient( const std::string & socketName ) {}
+VideoSocketClient::VideoSocketClient( const std::string & socketName, unsigned int width, unsigned int height, unsigned int ringSize ) {}
+VideoSocketClient::VideoSocketClient( int socketFD, unsigned int width, unsigned int height, unsigned int ringSize ) {}
 VideoSocketClient::~VideoSocketClient() {}
-bool VideoSocketClient::receiveFrame( Frame & frame ) { return false; }
+int VideoSocketClient::receiveFrame() { return -1; }
 #else
 
 
 #include <iostream>
 #include <stdexcept>
 #include <system_error>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 #include <unistd.h>
 #include <fcntl.h>
@@ -52,18 +56,28 @@ std::runtime_error( std::string(__PRETTY_FUNCTION__) + std::string(": ") + (what
 using namespace PointIR;
 
 
-VideoSocketClient::VideoSocketClient( const std::string & socketName )
+static void setNonblocking( int socketFD )
+{
+	int flags = fcntl( socketFD, F_GETFL, 0 );
+	if( -1 == flags )
+		throw SYSTEM_ERROR( errno, "fcntl" );
+	if( -1 == fcntl( socketFD, F_SETFL, flags | O_NONBLOCK ) )
+		throw SYSTEM_ERROR( errno, "fcntl" );
+}
+
+
+// larger frame headers are garbage rather than a camera
+static const size_t maxFrameSize = 64 * 1024 * 1024;
+
+
+VideoSocketClient::VideoSocketClient( const std::string & socketName, unsigned int width, unsigned int height, unsigned int ringSize )
 {
 	this->socketFD = socket( AF_UNIX, SOCK_SEQPACKET, 0 );
 	if( -1 == this->socketFD )
 		throw SYSTEM_ERROR( errno, "socket" );
 
 	// set local socket nonblocking
-	int flags = fcntl( this->socketFD, F_GETFL, 0 );
-	if( -1 == flags )
-		throw SYSTEM_ERROR( errno, "fcntl" );
-	if( -1 == fcntl( this->socketFD, F_SETFL, flags | O_NONBLOCK ) )
-		throw SYSTEM_ERROR( errno, "fcntl" );
+	setNonblocking( this->socketFD );
 
 	struct sockaddr_un remoteAddr;
 	remoteAddr.sun_family = AF_UNIX;
@@ -71,42 +85,151 @@ VideoSocketClient::VideoSocketClient( const std::string & socketName )
 	size_t len = strlen(remoteAddr.sun_path) + sizeof(remoteAddr.sun_family);
 	if( -1 == connect( this->socketFD, (struct sockaddr *)&remoteAddr, len ) )
 		throw SYSTEM_ERROR( errno, "connect" );
+
+	this->allocateRing( width, height, ringSize );
+}
+
+
+VideoSocketClient::VideoSocketClient( int socketFD, unsigned int width, unsigned int height, unsigned int ringSize )
+	: socketFD( socketFD )
+{
+	setNonblocking( this->socketFD );
+	this->allocateRing( width, height, ringSize );
 }
 
 
 VideoSocketClient::~VideoSocketClient()
 {
 	close( this->socketFD );
+	for( Slot & slot : this->slots )
+		free( slot.data );
 }
 
 
-bool VideoSocketClient::receiveFrame( Frame & frame ) const
+void VideoSocketClient::allocateRing( unsigned int width, unsigned int height, unsigned int ringSize )
 {
-	ssize_t received;
+	// one slot keeps the newest frame while the others are drained
+	ringSize = std::max( 2u, ringSize );
+	this->pageSize = sysconf( _SC_PAGESIZE );
+	this->slotSize = ( sizeof(PointIR_Frame) + (size_t)width * height + this->pageSize - 1 ) / this->pageSize * this->pageSize;
+	this->slots.resize( ringSize );
+	for( Slot & slot : this->slots )
+		this->allocateSlot( slot );
+
+	this->targets.resize( ringSize );
+	this->iovecs.resize( ringSize );
+	this->messages.resize( ringSize );
+	for( unsigned int i = 0; i < ringSize; i++ )
+	{
+		std::memset( &this->messages[i], 0, sizeof(this->messages[i]) );
+		this->messages[i].msg_hdr.msg_iov = &this->iovecs[i];
+		this->messages[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+
+void VideoSocketClient::allocateSlot( Slot & slot )
+{
+	free( slot.data );
+	slot.data = nullptr;
+	slot.size = 0;
+	void * data = nullptr;
+	int error = posix_memalign( &data, this->pageSize, this->slotSize );
+	if( error )
+		throw SYSTEM_ERROR( error, "posix_memalign" );
+	slot.data = (uint8_t *)data;
+	slot.size = this->slotSize;
+}
+
 
-	// peek at the next packet - return last frame if nothing received
-	PointIR_Frame peek;
-	received = recv( this->socketFD, &peek, sizeof(peek), MSG_PEEK );
-	if( -1 == received )
+void VideoSocketClient::discardPending()
+{
+	PointIR_Frame header;
+	for( ;; )
+	{
+		ssize_t received = recv( this->socketFD, &header, sizeof(header), MSG_DONTWAIT | MSG_TRUNC );
+		// 0 is an empty packet or a closed socket - the hang up is seen by whoever waits on the socket
+		if( 0 == received )
+			break;
+		if( received < 0 )
+		{
+			if( EAGAIN == errno || EWOULDBLOCK == errno )
+				break;
+			else
+				throw SYSTEM_ERROR( errno, "recv" );
+		}
+		this->droppedFrames++;
+	}
+}
+
+
+int VideoSocketClient::receiveFrame()
+{
+	int newest = -1;
+	for( ;; )
 	{
-		if( EAGAIN == errno || EWOULDBLOCK == errno )
-			return false;
-		else
-			throw SYSTEM_ERROR( errno, "recv" );
+		// receive into every slot except the lent ones and the newest one so far - a broken packet must not replace it
+		unsigned int count = 0;
+		for( unsigned int slot = 0; slot < this->slots.size(); slot++ )
+		{
+			if( this->slots[slot].lent || (int)slot == newest )
+				continue;
+			if( this->slots[slot].size < this->slotSize )
+				this->allocateSlot( this->slots[slot] );
+			this->targets[count] = slot;
+			this->iovecs[count].iov_base = this->slots[slot].data;
+			this->iovecs[count].iov_len = this->slots[slot].size;
+			count++;
+		}
+		if( !count )
+		{
+			this->discardPending();
+			break;
+		}
+
+		int received = recvmmsg( this->socketFD, this->messages.data(), count, MSG_DONTWAIT, nullptr );
+		if( -1 == received )
+		{
+			if( EAGAIN == errno || EWOULDBLOCK == errno )
+				break;
+			else
+				throw SYSTEM_ERROR( errno, "recvmmsg" );
+		}
+		if( 0 == received )
+			break;
+
+		for( int i = 0; i < received; i++ )
+		{
+			const PointIR_Frame * frame = (const PointIR_Frame *)this->iovecs[i].iov_base;
+			size_t length = this->messages[i].msg_len;
+			size_t frameSize = length < sizeof(PointIR_Frame) ? 0 : sizeof(PointIR_Frame) + (size_t)frame->width * frame->height;
+			if( this->messages[i].msg_hdr.msg_flags & MSG_TRUNC )
+			{
+				// the camera is larger than expected - the slots grow before they are received into again
+				if( frameSize > this->slotSize && frameSize <= maxFrameSize )
+					this->slotSize = ( frameSize + this->pageSize - 1 ) / this->pageSize * this->pageSize;
+				this->rejectedFrames++;
+				continue;
+			}
+			if( !frameSize || length != frameSize )
+			{
+				this->rejectedFrames++;
+				continue;
+			}
+			if( -1 != newest )
+				this->droppedFrames++;
+			newest = this->targets[i];
+		}
+
+		// a partial batch means the socket is drained
+		if( (unsigned int)received < count )
+			break;
 	}
-	if( sizeof(peek) != received )
-		throw RUNTIME_ERROR( "too few data received" );
-
-	// resize packet buffer if needed
-	frame.resize( peek.width, peek.height );
-
-	// receive the packet
-	received = recv( this->socketFD, (PointIR_Frame*)frame, sizeof(PointIR_Frame)+frame.size(), 0 );
-	if( -1 == received )
-		throw SYSTEM_ERROR( errno, "recv" );
-	if( sizeof(PointIR_Frame)+frame.size() != (size_t)received )
-		throw RUNTIME_ERROR( "too few data received" );
-	return true;
+
+	if( -1 == newest )
+		return -1;
+	this->slots[newest].lent = true;
+	return newest;
 }
 
 
@@ -24,18 +24,64 @@
 #include <PointIR/Frame.h>
 
 #include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/socket.h>
 
 
 namespace PointIR
 {
+	/*
+	 * Receives into a ring of page aligned frame buffers. Every call drains all pending packets
+	 * with recvmmsg and lends out only the newest frame - its slot is not received into until it
+	 * is released. Slots are sized for width x height frames up front and grow once if the camera
+	 * sends larger ones, so nothing is allocated in steady state.
+	 */
 	class VideoSocketClient
 	{
 	public:
-		VideoSocketClient( const std::string & socketName = "/tmp/PointIR.video.socket" );
+		VideoSocketClient( const VideoSocketClient & ) = delete;
+		VideoSocketClient & operator=( const VideoSocketClient & ) = delete;
+
+		VideoSocketClient( const std::string & socketName = "/tmp/PointIR.video.socket", unsigned int width = 640, unsigned int height = 480, unsigned int ringSize = 4 );
+		// takes over an already connected SOCK_SEQPACKET socket, e.g. one end of a socketpair
+		VideoSocketClient( int socketFD, unsigned int width = 640, unsigned int height = 480, unsigned int ringSize = 4 );
 		virtual ~VideoSocketClient();
-		bool receiveFrame( Frame & frame ) const;
+
+		// the slot of the newest frame, -1 if no frame arrived since the last call
+		int receiveFrame();
+		const PointIR_Frame * getFrame( int slot ) const { return (const PointIR_Frame *)this->slots[slot].data; }
+		void releaseFrame( int slot ) { this->slots[slot].lent = false; }
+
+		unsigned int getRingSize() const { return this->slots.size(); }
+		// frames that were replaced by newer ones, or arrived while no slot was free
+		unsigned int getDroppedFrames() const { return this->droppedFrames; }
+		// packets that were not a whole frame - a frame larger than the slots only once, as they grow
+		unsigned int getRejectedFrames() const { return this->rejectedFrames; }
+		// for waiting on new frames with select, poll or epoll
+		int getFD() const { return this->socketFD; }
 	private:
+		struct Slot
+		{
+			uint8_t * data = nullptr;
+			size_t size = 0;
+			bool lent = false;
+		};
+
+		void allocateRing( unsigned int width, unsigned int height, unsigned int ringSize );
+		void allocateSlot( Slot & slot );
+		void discardPending();
+
 		int socketFD;
+		size_t pageSize = 0;
+		size_t slotSize = 0;
+		std::vector< Slot > slots;
+		std::vector< unsigned int > targets;
+		std::vector< struct iovec > iovecs;
+		std::vector< struct mmsghdr > messages;
+		unsigned int droppedFrames = 0;
+		unsigned int rejectedFrames = 0;
 	};
 }
 
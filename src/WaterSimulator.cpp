@@ -0,0 +1,490 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WaterSimulator.hpp"
+#include "ThreadPool.hpp"
+
+#include <exceptions.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+	#define WATERSIMULATOR_X86
+	#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define WATERSIMULATOR_NEON
+	#include <arm_neon.h>
+#endif
+
+
+// must match the vertices of centeredCirclePC drawn by the GPU modulator
+static const unsigned int circleSegments = 8;
+
+static const float unorm8Scale = 1.0f / 255.0f;
+
+// b and a are unused - they hold 0.0 biased by 0.5 like encode() in waterEncodingSRC_unorm8 writes them
+static const uint8_t unusedUnorm8 = 128;
+static const uint32_t unusedBA = ( (uint32_t)unusedUnorm8 << 16 ) | ( (uint32_t)unusedUnorm8 << 24 );
+
+// bytes written per tile - together with the rows read it should stay within a typical L2 cache
+static const unsigned int tileBytes = 64 * 1024;
+
+
+////////////////////////////////////////////////////////////////
+// Scalar
+
+static inline uint8_t toUnorm8( float x )
+{
+	x = std::max( x, 0.0f );
+	x = std::min( x, 1.0f );
+	return (uint8_t)( x * 255.0f + 0.5f );
+}
+
+
+static inline void stepPixel( const uint8_t * center, const uint8_t * left, const uint8_t * right, const uint8_t * below, const uint8_t * above, uint8_t * out )
+{
+	// same sequence of operations as in fragmentShaderSRC_water
+	float height = center[0] * unorm8Scale - 0.5f;
+	float velocity = center[1] * unorm8Scale - 0.5f;
+
+	float leftHeight = left[0] * unorm8Scale;
+	float rightHeight = right[0] * unorm8Scale;
+	float belowHeight = below[0] * unorm8Scale;
+	float aboveHeight = above[0] * unorm8Scale;
+	float averageHeight = 0.25f * ( leftHeight + rightHeight + belowHeight + aboveHeight );
+	averageHeight -= 0.5f;
+
+	velocity += ( averageHeight - height ) * 1.6f;
+	velocity -= height * 0.06f;
+	velocity *= 0.98f;
+	height += velocity;
+
+	out[0] = toUnorm8( height + 0.5f );
+	out[1] = toUnorm8( velocity + 0.5f );
+	out[2] = unusedUnorm8;
+	out[3] = unusedUnorm8;
+}
+
+
+// steps pixels [xBegin,xEnd) of a row - neighbors are clamped to the edge like GL_CLAMP_TO_EDGE does
+static inline void stepRowScalar( const uint8_t * row, const uint8_t * rowBelow, const uint8_t * rowAbove, uint8_t * out, unsigned int width, unsigned int xBegin, unsigned int xEnd )
+{
+	for( unsigned int x = xBegin; x < xEnd; x++ )
+	{
+		unsigned int xl = x ? x - 1 : 0;
+		unsigned int xr = x + 1 < width ? x + 1 : x;
+		stepPixel( row + 4*x, row + 4*xl, row + 4*xr, rowBelow + 4*x, rowAbove + 4*x, out + 4*x );
+	}
+}
+
+
+static void stepScalar( const uint8_t * src, uint8_t * dst, unsigned int width, unsigned int height, unsigned int rowBegin, unsigned int rowEnd )
+{
+	for( unsigned int y = rowBegin; y < rowEnd; y++ )
+	{
+		const uint8_t * row = src + 4*width*y;
+		const uint8_t * rowBelow = src + 4*width*( y ? y - 1 : 0 );
+		const uint8_t * rowAbove = src + 4*width*( y + 1 < height ? y + 1 : y );
+		stepRowScalar( row, rowBelow, rowAbove, dst + 4*width*y, width, 0, width );
+	}
+}
+
+
+////////////////////////////////////////////////////////////////
+// SSE2 and AVX2
+
+#ifdef WATERSIMULATOR_X86
+
+__attribute__(( target("sse2") ))
+static inline __m128 channelSSE2( __m128i pixels, int shift )
+{
+	return _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( pixels, shift ), _mm_set1_epi32( 0xff ) ) ), _mm_set1_ps( unorm8Scale ) );
+}
+
+
+__attribute__(( target("sse2") ))
+static inline __m128i unorm8SSE2( __m128 x )
+{
+	x = _mm_min_ps( _mm_max_ps( x, _mm_set1_ps( 0.0f ) ), _mm_set1_ps( 1.0f ) );
+	return _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( 255.0f ) ), _mm_set1_ps( 0.5f ) ) );
+}
+
+
+__attribute__(( target("sse2") ))
+static void stepSSE2( const uint8_t * src, uint8_t * dst, unsigned int width, unsigned int height, unsigned int rowBegin, unsigned int rowEnd )
+{
+	const __m128 half = _mm_set1_ps( 0.5f );
+	const __m128 quarter = _mm_set1_ps( 0.25f );
+
+	for( unsigned int y = rowBegin; y < rowEnd; y++ )
+	{
+		const uint8_t * row = src + 4*width*y;
+		const uint8_t * rowBelow = src + 4*width*( y ? y - 1 : 0 );
+		const uint8_t * rowAbove = src + 4*width*( y + 1 < height ? y + 1 : y );
+		uint8_t * out = dst + 4*width*y;
+
+		// the first and last column need clamped neighbors
+		unsigned int x = std::min( 1u, width );
+		stepRowScalar( row, rowBelow, rowAbove, out, width, 0, x );
+		for( ; x + 4 < width; x += 4 )
+		{
+			__m128i center = _mm_loadu_si128( (const __m128i *)( row + 4*x ) );
+			__m128 heightValue = _mm_sub_ps( channelSSE2( center, 0 ), half );
+			__m128 velocity = _mm_sub_ps( channelSSE2( center, 8 ), half );
+
+			__m128 leftHeight = channelSSE2( _mm_loadu_si128( (const __m128i *)( row + 4*(x-1) ) ), 0 );
+			__m128 rightHeight = channelSSE2( _mm_loadu_si128( (const __m128i *)( row + 4*(x+1) ) ), 0 );
+			__m128 belowHeight = channelSSE2( _mm_loadu_si128( (const __m128i *)( rowBelow + 4*x ) ), 0 );
+			__m128 aboveHeight = channelSSE2( _mm_loadu_si128( (const __m128i *)( rowAbove + 4*x ) ), 0 );
+			__m128 averageHeight = _mm_mul_ps( quarter, _mm_add_ps( _mm_add_ps( _mm_add_ps( leftHeight, rightHeight ), belowHeight ), aboveHeight ) );
+			averageHeight = _mm_sub_ps( averageHeight, half );
+
+			velocity = _mm_add_ps( velocity, _mm_mul_ps( _mm_sub_ps( averageHeight, heightValue ), _mm_set1_ps( 1.6f ) ) );
+			velocity = _mm_sub_ps( velocity, _mm_mul_ps( heightValue, _mm_set1_ps( 0.06f ) ) );
+			velocity = _mm_mul_ps( velocity, _mm_set1_ps( 0.98f ) );
+			heightValue = _mm_add_ps( heightValue, velocity );
+
+			__m128i r = unorm8SSE2( _mm_add_ps( heightValue, half ) );
+			__m128i g = unorm8SSE2( _mm_add_ps( velocity, half ) );
+			__m128i rgba = _mm_or_si128( _mm_or_si128( r, _mm_slli_epi32( g, 8 ) ), _mm_set1_epi32( (int)unusedBA ) );
+			_mm_storeu_si128( (__m128i *)( out + 4*x ), rgba );
+		}
+		stepRowScalar( row, rowBelow, rowAbove, out, width, x, width );
+	}
+}
+
+
+// no FMA here on purpose - separate multiplies and adds keep the results identical to the other kernels
+__attribute__(( target("avx2") ))
+static inline __m256 channelAVX2( __m256i pixels, int shift )
+{
+	return _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_and_si256( _mm256_srli_epi32( pixels, shift ), _mm256_set1_epi32( 0xff ) ) ), _mm256_set1_ps( unorm8Scale ) );
+}
+
+
+__attribute__(( target("avx2") ))
+static inline __m256i unorm8AVX2( __m256 x )
+{
+	x = _mm256_min_ps( _mm256_max_ps( x, _mm256_set1_ps( 0.0f ) ), _mm256_set1_ps( 1.0f ) );
+	return _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( x, _mm256_set1_ps( 255.0f ) ), _mm256_set1_ps( 0.5f ) ) );
+}
+
+
+__attribute__(( target("avx2") ))
+static void stepAVX2( const uint8_t * src, uint8_t * dst, unsigned int width, unsigned int height, unsigned int rowBegin, unsigned int rowEnd )
+{
+	const __m256 half = _mm256_set1_ps( 0.5f );
+	const __m256 quarter = _mm256_set1_ps( 0.25f );
+
+	for( unsigned int y = rowBegin; y < rowEnd; y++ )
+	{
+		const uint8_t * row = src + 4*width*y;
+		const uint8_t * rowBelow = src + 4*width*( y ? y - 1 : 0 );
+		const uint8_t * rowAbove = src + 4*width*( y + 1 < height ? y + 1 : y );
+		uint8_t * out = dst + 4*width*y;
+
+		unsigned int x = std::min( 1u, width );
+		stepRowScalar( row, rowBelow, rowAbove, out, width, 0, x );
+		for( ; x + 8 < width; x += 8 )
+		{
+			__m256i center = _mm256_loadu_si256( (const __m256i *)( row + 4*x ) );
+			__m256 heightValue = _mm256_sub_ps( channelAVX2( center, 0 ), half );
+			__m256 velocity = _mm256_sub_ps( channelAVX2( center, 8 ), half );
+
+			__m256 leftHeight = channelAVX2( _mm256_loadu_si256( (const __m256i *)( row + 4*(x-1) ) ), 0 );
+			__m256 rightHeight = channelAVX2( _mm256_loadu_si256( (const __m256i *)( row + 4*(x+1) ) ), 0 );
+			__m256 belowHeight = channelAVX2( _mm256_loadu_si256( (const __m256i *)( rowBelow + 4*x ) ), 0 );
+			__m256 aboveHeight = channelAVX2( _mm256_loadu_si256( (const __m256i *)( rowAbove + 4*x ) ), 0 );
+			__m256 averageHeight = _mm256_mul_ps( quarter, _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( leftHeight, rightHeight ), belowHeight ), aboveHeight ) );
+			averageHeight = _mm256_sub_ps( averageHeight, half );
+
+			velocity = _mm256_add_ps( velocity, _mm256_mul_ps( _mm256_sub_ps( averageHeight, heightValue ), _mm256_set1_ps( 1.6f ) ) );
+			velocity = _mm256_sub_ps( velocity, _mm256_mul_ps( heightValue, _mm256_set1_ps( 0.06f ) ) );
+			velocity = _mm256_mul_ps( velocity, _mm256_set1_ps( 0.98f ) );
+			heightValue = _mm256_add_ps( heightValue, velocity );
+
+			__m256i r = unorm8AVX2( _mm256_add_ps( heightValue, half ) );
+			__m256i g = unorm8AVX2( _mm256_add_ps( velocity, half ) );
+			__m256i rgba = _mm256_or_si256( _mm256_or_si256( r, _mm256_slli_epi32( g, 8 ) ), _mm256_set1_epi32( (int)unusedBA ) );
+			_mm256_storeu_si256( (__m256i *)( out + 4*x ), rgba );
+		}
+		stepRowScalar( row, rowBelow, rowAbove, out, width, x, width );
+	}
+}
+
+#endif
+
+
+////////////////////////////////////////////////////////////////
+// NEON
+
+#ifdef WATERSIMULATOR_NEON
+
+static inline float32x4_t channelNEON( uint32x4_t pixels, int shift = 0 )
+{
+	// vshrq_n_u32 needs an immediate shift
+	if( shift )
+		pixels = vshrq_n_u32( pixels, 8 );
+	return vmulq_f32( vcvtq_f32_u32( vandq_u32( pixels, vdupq_n_u32( 0xff ) ) ), vdupq_n_f32( unorm8Scale ) );
+}
+
+
+// vmlaq_f32 may be fused on some cores - separate multiplies and adds keep the results identical to the other kernels
+static inline uint32x4_t unorm8NEON( float32x4_t x )
+{
+	x = vminq_f32( vmaxq_f32( x, vdupq_n_f32( 0.0f ) ), vdupq_n_f32( 1.0f ) );
+	return vcvtq_u32_f32( vaddq_f32( vmulq_f32( x, vdupq_n_f32( 255.0f ) ), vdupq_n_f32( 0.5f ) ) );
+}
+
+
+static inline uint32x4_t loadNEON( const uint8_t * pixels )
+{
+	return vreinterpretq_u32_u8( vld1q_u8( pixels ) );
+}
+
+
+static void stepNEON( const uint8_t * src, uint8_t * dst, unsigned int width, unsigned int height, unsigned int rowBegin, unsigned int rowEnd )
+{
+	const float32x4_t half = vdupq_n_f32( 0.5f );
+	const float32x4_t quarter = vdupq_n_f32( 0.25f );
+
+	for( unsigned int y = rowBegin; y < rowEnd; y++ )
+	{
+		const uint8_t * row = src + 4*width*y;
+		const uint8_t * rowBelow = src + 4*width*( y ? y - 1 : 0 );
+		const uint8_t * rowAbove = src + 4*width*( y + 1 < height ? y + 1 : y );
+		uint8_t * out = dst + 4*width*y;
+
+		unsigned int x = std::min( 1u, width );
+		stepRowScalar( row, rowBelow, rowAbove, out, width, 0, x );
+		for( ; x + 4 < width; x += 4 )
+		{
+			uint32x4_t center = loadNEON( row + 4*x );
+			float32x4_t heightValue = vsubq_f32( channelNEON( center ), half );
+			float32x4_t velocity = vsubq_f32( channelNEON( center, 8 ), half );
+
+			float32x4_t leftHeight = channelNEON( loadNEON( row + 4*(x-1) ) );
+			float32x4_t rightHeight = channelNEON( loadNEON( row + 4*(x+1) ) );
+			float32x4_t belowHeight = channelNEON( loadNEON( rowBelow + 4*x ) );
+			float32x4_t aboveHeight = channelNEON( loadNEON( rowAbove + 4*x ) );
+			float32x4_t averageHeight = vmulq_f32( quarter, vaddq_f32( vaddq_f32( vaddq_f32( leftHeight, rightHeight ), belowHeight ), aboveHeight ) );
+			averageHeight = vsubq_f32( averageHeight, half );
+
+			velocity = vaddq_f32( velocity, vmulq_f32( vsubq_f32( averageHeight, heightValue ), vdupq_n_f32( 1.6f ) ) );
+			velocity = vsubq_f32( velocity, vmulq_f32( heightValue, vdupq_n_f32( 0.06f ) ) );
+			velocity = vmulq_f32( velocity, vdupq_n_f32( 0.98f ) );
+			heightValue = vaddq_f32( heightValue, velocity );
+
+			uint32x4_t r = unorm8NEON( vaddq_f32( heightValue, half ) );
+			uint32x4_t g = unorm8NEON( vaddq_f32( velocity, half ) );
+			uint32x4_t rgba = vorrq_u32( vorrq_u32( r, vshlq_n_u32( g, 8 ) ), vdupq_n_u32( unusedBA ) );
+			vst1q_u8( out + 4*x, vreinterpretq_u8_u32( rgba ) );
+		}
+		stepRowScalar( row, rowBelow, rowAbove, out, width, x, width );
+	}
+}
+
+#endif
+
+
+////////////////////////////////////////////////////////////////
+// WaterSimulator
+
+bool WaterSimulator::isSupported( Kernel kernel )
+{
+	switch( kernel )
+	{
+	case Kernel::Auto:
+	case Kernel::Scalar:
+		return true;
+#ifdef WATERSIMULATOR_X86
+	case Kernel::SSE2:
+		return __builtin_cpu_supports( "sse2" );
+	case Kernel::AVX2:
+		return __builtin_cpu_supports( "avx2" );
+#endif
+#ifdef WATERSIMULATOR_NEON
+	case Kernel::NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+
+WaterSimulator::Kernel WaterSimulator::getBestKernel()
+{
+	for( Kernel kernel : { Kernel::AVX2, Kernel::SSE2, Kernel::NEON } )
+		if( isSupported( kernel ) )
+			return kernel;
+	return Kernel::Scalar;
+}
+
+
+const char * WaterSimulator::getName( Kernel kernel )
+{
+	switch( kernel )
+	{
+	case Kernel::Auto:   return "auto";
+	case Kernel::Scalar: return "scalar";
+	case Kernel::SSE2:   return "sse2";
+	case Kernel::AVX2:   return "avx2";
+	case Kernel::NEON:   return "neon";
+	}
+	return "unknown";
+}
+
+
+WaterSimulator::Kernel WaterSimulator::getKernel( const std::string & name )
+{
+	for( Kernel kernel : { Kernel::Auto, Kernel::Scalar, Kernel::SSE2, Kernel::AVX2, Kernel::NEON } )
+		if( name == getName( kernel ) )
+			return kernel;
+	throw RUNTIME_ERROR( "Unknown water simulator kernel \"" + name + "\"" );
+}
+
+
+void WaterSimulator::step( Kernel kernel, const uint8_t * src, uint8_t * dst, unsigned int width, unsigned int height, unsigned int rowBegin, unsigned int rowEnd )
+{
+	switch( kernel )
+	{
+#ifdef WATERSIMULATOR_X86
+	case Kernel::SSE2:
+		stepSSE2( src, dst, width, height, rowBegin, rowEnd );
+		break;
+	case Kernel::AVX2:
+		stepAVX2( src, dst, width, height, rowBegin, rowEnd );
+		break;
+#endif
+#ifdef WATERSIMULATOR_NEON
+	case Kernel::NEON:
+		stepNEON( src, dst, width, height, rowBegin, rowEnd );
+		break;
+#endif
+	case Kernel::Auto:
+		step( getBestKernel(), src, dst, width, height, rowBegin, rowEnd );
+		break;
+	default:
+		stepScalar( src, dst, width, height, rowBegin, rowEnd );
+		break;
+	}
+}
+
+
+WaterSimulator::WaterSimulator( unsigned int width, unsigned int height, Kernel kernel, ThreadPool * threadPool )
+{
+	if( kernel == Kernel::Auto )
+		kernel = getBestKernel();
+	if( !isSupported( kernel ) )
+		throw RUNTIME_ERROR( std::string("Water simulator kernel \"") + getName( kernel ) + "\" is not supported on this CPU" );
+
+	this->kernel = kernel;
+	this->threadPool = threadPool;
+	this->width = width;
+	this->height = height;
+	this->tileRows = std::max( 1u, tileBytes / std::max( 1u, 4*width ) );
+	// same as the initial clear of a FrameBuffer2D
+	this->src.assign( 4*width*height, toUnorm8( 0.5f ) );
+	this->dst.assign( 4*width*height, toUnorm8( 0.5f ) );
+}
+
+
+WaterSimulator::~WaterSimulator()
+{
+}
+
+
+void WaterSimulator::disturb( const float position[2], float scale )
+{
+	// rasterize the same polygon as render_waterModulator does: a fan of circleSegments vertices in normalized device coordinates
+	float vertices[circleSegments][2];
+	for( unsigned int i = 0; i < circleSegments; i++ )
+	{
+		vertices[i][0] = std::sin( (2.0*M_PI/circleSegments)*i ) * scale + position[0];
+		vertices[i][1] = std::cos( (2.0*M_PI/circleSegments)*i ) * scale + position[1];
+	}
+
+	int xMin = std::max( 0, (int)std::floor( ( position[0] - scale + 1.0f ) * 0.5f * this->width ) );
+	int xMax = std::min( (int)this->width - 1, (int)std::ceil( ( position[0] + scale + 1.0f ) * 0.5f * this->width ) );
+	int yMin = std::max( 0, (int)std::floor( ( position[1] - scale + 1.0f ) * 0.5f * this->height ) );
+	int yMax = std::min( (int)this->height - 1, (int)std::ceil( ( position[1] + scale + 1.0f ) * 0.5f * this->height ) );
+
+	const uint8_t color[4] = { toUnorm8( 0.0f ), toUnorm8( 0.5f ), toUnorm8( 0.5f ), toUnorm8( 0.5f ) };
+	for( int y = yMin; y <= yMax; y++ )
+	{
+		float py = ( ( y + 0.5f ) / this->height ) * 2.0f - 1.0f;
+		for( int x = xMin; x <= xMax; x++ )
+		{
+			float px = ( ( x + 0.5f ) / this->width ) * 2.0f - 1.0f;
+			// the fan winds clockwise, so the pixel center is inside if it is right of every edge
+			bool inside = true;
+			for( unsigned int i = 0; i < circleSegments && inside; i++ )
+			{
+				const float * a = vertices[i];
+				const float * b = vertices[ (i+1) % circleSegments ];
+				inside = ( b[0] - a[0] ) * ( py - a[1] ) - ( b[1] - a[1] ) * ( px - a[0] ) <= 0.0f;
+			}
+			if( inside )
+				std::copy( color, color + 4, &this->src[ 4*( this->width*y + x ) ] );
+		}
+	}
+}
+
+
+void WaterSimulator::step()
+{
+	this->step( 0, this->height );
+}
+
+
+void WaterSimulator::step( unsigned int rowBegin, unsigned int rowEnd )
+{
+	rowEnd = std::min( rowEnd, this->height );
+	if( rowBegin >= rowEnd )
+		return;
+
+	if( this->threadPool && this->threadPool->getThreadCount() > 1 )
+	{
+		const uint8_t * src = this->src.data();
+		uint8_t * dst = this->dst.data();
+		unsigned int tiles = ( rowEnd - rowBegin + this->tileRows - 1 ) / this->tileRows;
+		this->threadPool->run( tiles, [=]( unsigned int tile )
+		{
+			unsigned int tileBegin = rowBegin + tile * this->tileRows;
+			unsigned int tileEnd = std::min( tileBegin + this->tileRows, rowEnd );
+			step( this->kernel, src, dst, this->width, this->height, tileBegin, tileEnd );
+		} );
+	}
+	else
+	{
+		step( this->kernel, this->src.data(), this->dst.data(), this->width, this->height, rowBegin, rowEnd );
+	}
+	std::swap( this->src, this->dst );
+}
+
+
+void WaterSimulator::clear()
+{
+	std::fill( this->src.begin(), this->src.end(), toUnorm8( 0.5f ) );
+	std::fill( this->dst.begin(), this->dst.end(), toUnorm8( 0.5f ) );
+}
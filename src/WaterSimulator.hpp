@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WATERSIMULATOR_INCLUDED_
+#define _WATERSIMULATOR_INCLUDED_
+
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+
+class ThreadPool;
+
+
+/**
+ * CPU implementation of the water shader (fragmentShaderSRC_water).
+ *
+ * The state is kept in the same RGBA8 layout the shader uses (height and velocity biased
+ * by 0.5, b and a unused) with the first row being the bottom of the texture,
+ * so it can be uploaded to a Texture2D as is.
+ * Every kernel performs the exact same sequence of single precision operations, so all of
+ * them produce bit-identical results.
+ *
+ * With a ThreadPool a step is split into tiles of rows that fit into the cache. Source and
+ * destination are separate buffers, so the one row halo above and below a tile is simply
+ * read from the shared source buffer and tiles can be processed in any order.
+ *
+ * step( rowBegin, rowEnd ) leaves the other rows alone in both buffers, so it is only correct
+ * as long as the water outside the range is calm - see DirtyRegion.
+ */
+class WaterSimulator
+{
+public:
+	enum class Kernel
+	{
+		Auto,
+		Scalar,
+		SSE2,
+		AVX2,
+		NEON
+	};
+
+	static bool isSupported( Kernel kernel );
+	static Kernel getBestKernel();
+	static const char * getName( Kernel kernel );
+	static Kernel getKernel( const std::string & name );
+
+	static void step( Kernel kernel, const uint8_t * src, uint8_t * dst, unsigned int width, unsigned int height, unsigned int rowBegin, unsigned int rowEnd );
+
+	WaterSimulator( const WaterSimulator & ) = delete;
+	WaterSimulator & operator=( const WaterSimulator & ) = delete;
+
+	WaterSimulator( unsigned int width, unsigned int height, Kernel kernel = Kernel::Auto, ThreadPool * threadPool = nullptr );
+	virtual ~WaterSimulator();
+
+	void disturb( const float position[2], float scale );
+	void step();
+	void step( unsigned int rowBegin, unsigned int rowEnd );
+	void clear();
+
+	const uint8_t * getData() const
+	{
+		return this->src.data();
+	}
+
+	uint8_t * getData()
+	{
+		return this->src.data();
+	}
+
+	Kernel getKernel() const
+	{
+		return this->kernel;
+	}
+
+	unsigned int getWidth() const
+	{
+		return this->width;
+	}
+
+	unsigned int getHeight() const
+	{
+		return this->height;
+	}
+
+	unsigned int getTileRows() const
+	{
+		return this->tileRows;
+	}
+
+private:
+	Kernel kernel;
+	ThreadPool * threadPool = nullptr;
+	unsigned int tileRows = 0;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::vector< uint8_t > src;
+	std::vector< uint8_t > dst;
+};
+
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Packs images into an asset pack glesPond maps at startup (--assetPack). Images are stored the way
+// Texture2D uploads them - decoded by DevIL, or as the compressed levels of a KTX file.
+
+#include "AssetPack.hpp"
+#include "Image.hpp"
+
+#include <exceptions.hpp>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+
+#include <getopt.h>
+
+#include <IL/il.h>
+
+
+void print_usage( int argc, char ** argv )
+{
+	printf
+	(
+		"Usage: %s [--maxSize=<width>x<height>] <output pack> <input images...>\n"
+		"Images are looked up by the names given here.\n",
+		argv[0]
+	);
+}
+
+
+int main( int argc, char ** argv )
+{
+	unsigned int maxWidth = 0;
+	unsigned int maxHeight = 0;
+
+	static struct option long_options[] =
+	{
+		{ "maxSize",                required_argument, 0, 'M' },
+		{ 0,           0,                              0, 0   }
+	};
+
+	int opt = 0;
+	int option_index = 0;
+	while( ( opt = getopt_long( argc, argv, "M:", long_options, &option_index ) ) != -1 )
+	{
+		switch( opt )
+		{
+		case 'M':
+			if( sscanf( optarg, "%ux%u", &maxWidth, &maxHeight ) != 2 )
+			{
+				fprintf( stderr, "Invalid size \"%s\"!\n", optarg );
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			print_usage( argc, argv );
+			return EXIT_FAILURE;
+		}
+	}
+	if( argc - optind < 2 )
+	{
+		print_usage( argc, argv );
+		return EXIT_FAILURE;
+	}
+	std::string output = argv[optind];
+
+	ilInit();
+	ilEnable( IL_ORIGIN_SET );
+	ilOriginFunc( IL_ORIGIN_LOWER_LEFT );
+
+	try
+	{
+		std::vector< std::unique_ptr< Image > > images;
+		std::vector< const Image * > entries;
+		for( int i = optind + 1; i < argc; i++ )
+		{
+			images.emplace_back( new Image( argv[i] ) );
+			Image & image = *images.back();
+			// compressed images were sized by the texture converter
+			if( !image.isCompressed() )
+				image.downscale( maxWidth, maxHeight );
+			entries.push_back( &image );
+			std::cout << image.getFile() << ": " << image.getWidth() << "x" << image.getHeight() << ", "
+			          << image.getLevels() << " levels, " << image.getTotalSize() << " bytes\n";
+		}
+		AssetPack::write( output, entries );
+	}
+	catch( const std::exception & e )
+	{
+		std::cerr << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
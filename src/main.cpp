@@ -22,9 +22,12 @@
 #include <stdexcept>
 #include <utility>
 #include <map>
+#include <algorithm>
 #include <vector>
 #include <cmath>
 #include <cstdlib>
+#include <chrono>
+#include <thread>
 #include <unistd.h>
 
 #include <getopt.h>
@@ -34,22 +37,34 @@
 
 #include <IL/il.h>
 
-#define GLM_FORCE_RADIANS
-#include <glm/vec3.hpp>
-#include <glm/vec4.hpp>
-#include <glm/mat4x4.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-
 #include "exceptions.hpp"
 #include "Program.hpp"
 #include "Shader.hpp"
 #include "Texture2D.hpp"
 #include "FrameBuffer2D.hpp"
+#include "StageTimer.hpp"
+#include "WaterSimulator.hpp"
+#include "ThreadPool.hpp"
+#include "FixedTimestep.hpp"
+#include "Touch.hpp"
+#include "TouchGrid.hpp"
+#include "School.hpp"
+#include "Random.hpp"
+#include "ImageLoader.hpp"
+#include "AssetPack.hpp"
+#include "ProgramCache.hpp"
+#include "GLState.hpp"
+#include "DirtyRegion.hpp"
 #include "Error.hpp"
 #ifdef GLESPOND_POINTIR
-	#include "VideoSocketClient.hpp"
-	#include "DBusClient.hpp"
+	#include "PointIRThread.hpp"
+	#include "StreamingTexture.hpp"
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/socket.h>
+	#include <cerrno>
+	#include <cstring>
+	#include <atomic>
 #endif
 
 
@@ -58,8 +73,12 @@
 
 
 #ifdef GLESPOND_POINTIR
-	static PointIR::DBusClient dbus;
-//	static PointIR::VideoSocketClient video;
+	static PointIRThread * pointIR = nullptr;
+	static Uint32 pointIREvent = 0; // wakes the event loop when the daemon replied
+	static StreamingTexture * cameraTexture = nullptr;
+	static bool cameraBlobs = false; // the latest frame has pixels above cameraThreshold
+	static float cameraBlobsPosition[2];
+	static float cameraBlobsRadius;
 #endif
 
 
@@ -109,31 +128,124 @@ void main()
 )GLSL";
 
 
+// How the water state (height and velocity) is stored in an RGBA texel. Inserted right after the #version line of every shader that reads or writes it.
+// The water simulators on the CPU only know unorm8.
+static const char * waterEncodingSRC_unorm8 =
+R"GLSL(
+precision lowp float;
+
+// signed values biased into [0,1] - 8 bits each, b and a are unused
+float decodeHeight( vec4 tex ) { return tex.r - 0.5; }
+float decodeVelocity( vec4 tex ) { return tex.g - 0.5; }
+vec4 encode( float height, float velocity ) { return vec4( height, velocity, 0.0, 0.0 ) + 0.5; }
+)GLSL";
+
+
+static const char * waterEncodingSRC_halfFloat =
+R"GLSL(
+precision mediump float;
+
+// GL_OES_texture_half_float render target - signed values as they are, b and a are unused
+float decodeHeight( vec4 tex ) { return tex.r; }
+float decodeVelocity( vec4 tex ) { return tex.g; }
+vec4 encode( float height, float velocity ) { return vec4( height, velocity, 0.0, 0.0 ); }
+)GLSL";
+
+
+static const char * waterEncodingSRC_packed16 =
+R"GLSL(
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+
+// height in r and g, velocity in b and a - 16 bits each
+// decoding is linear in the channels, so linearly filtered texels decode correctly
+float unpack( vec2 v ) { return v.x + v.y * (1.0/255.0) - 0.5; }
+vec2 pack( float v )
+{
+	v = clamp( v + 0.5, 0.0, 1.0 ) * 255.0;
+	float high = min( floor( v ), 254.0 );
+	return vec2( high * (1.0/255.0), v - high );
+}
+
+float decodeHeight( vec4 tex ) { return unpack( tex.rg ); }
+float decodeVelocity( vec4 tex ) { return unpack( tex.ba ); }
+vec4 encode( float height, float velocity ) { return vec4( pack( height ), pack( velocity ) ); }
+)GLSL";
+
+
+enum class WaterEncoding
+{
+	Auto,
+	Unorm8,
+	HalfFloat,
+	Packed16
+};
+
+static WaterEncoding waterEncoding = WaterEncoding::Unorm8;
+static const char * waterEncodingSRC = waterEncodingSRC_unorm8;
+
+
+// calm water in the current encoding
+void water_clear( const FrameBuffer2D * frameBuffer )
+{
+	switch( waterEncoding )
+	{
+	case WaterEncoding::HalfFloat:
+		frameBuffer->clear( 0.0f, 0.0f, 0.0f, 0.0f );
+		break;
+	case WaterEncoding::Packed16:
+		// pack( 0.0 ) - see waterEncodingSRC_packed16
+		frameBuffer->clear( 127.0f/255.0f, 0.5f, 127.0f/255.0f, 0.5f );
+		break;
+	default:
+		frameBuffer->clear( 0.5f, 0.5f, 0.5f, 0.5f );
+		break;
+	}
+}
+
+
+// steps after the last disturbance until the waves are flat - fragmentShaderSRC_water damps the velocity by 0.98 per step,
+// and smaller waves than 1/255 vanish in the 8 bits of the normal map no matter how precise the encoding is
+unsigned int water_settleSteps()
+{
+	return DirtyRegion::getSettleSteps( 0.98, 1.0/255.0 );
+}
+
+
+// inserts the functions of the water encoding after the #version line
+std::string water_shaderSource( const char * source )
+{
+	std::string result( source );
+	return result.insert( result.find( '\n' ) + 1, waterEncodingSRC );
+}
+
+
 // inspired by http://madebyevan.com/webgl-water/water.js
 static const char * fragmentShaderSRC_water =
 R"GLSL(#version 100
-varying lowp vec2 vTexCoord;
+varying vec2 vTexCoord;
 
 uniform sampler2D uTexture;
-uniform lowp vec2 uDeltaPixel;
+uniform vec2 uDeltaPixel;
 
 void main()
 {
-	lowp vec4 tex = texture2D( uTexture, vTexCoord );
+	vec4 tex = texture2D( uTexture, vTexCoord );
 
-	// convert unsigned texture data to signed data
-	lowp float height = tex.r - 0.5;
-	lowp float velocity = tex.g - 0.5;
+	float height = decodeHeight( tex );
+	float velocity = decodeVelocity( tex );
 
 	// calculate average neighbor height
-	lowp vec2 dcx = vec2( uDeltaPixel.x, 0.0 );
-	lowp vec2 dcy = vec2( 0.0, uDeltaPixel.y );
-	lowp float leftHeight = texture2D( uTexture, vTexCoord - dcx ).r;
-	lowp float rightHeight = texture2D( uTexture, vTexCoord + dcx ).r;
-	lowp float belowHeight = texture2D( uTexture, vTexCoord - dcy ).r;
-	lowp float aboveHeight = texture2D( uTexture, vTexCoord + dcy ).r;
-	lowp float averageHeight = 0.25 * ( leftHeight + rightHeight + belowHeight + aboveHeight );
-	averageHeight -= 0.5; // unsigned to signed
+	vec2 dcx = vec2( uDeltaPixel.x, 0.0 );
+	vec2 dcy = vec2( 0.0, uDeltaPixel.y );
+	float leftHeight = decodeHeight( texture2D( uTexture, vTexCoord - dcx ) );
+	float rightHeight = decodeHeight( texture2D( uTexture, vTexCoord + dcx ) );
+	float belowHeight = decodeHeight( texture2D( uTexture, vTexCoord - dcy ) );
+	float aboveHeight = decodeHeight( texture2D( uTexture, vTexCoord + dcy ) );
+	float averageHeight = 0.25 * ( leftHeight + rightHeight + belowHeight + aboveHeight );
 
 	// change the velocity to move toward the average
 	velocity += (averageHeight - height) * 1.6;
@@ -147,15 +259,27 @@ void main()
 	// update current height
 	height += velocity;
 
-	// convert signed data back to unsigned data
-	tex.r = height + 0.5;
-	tex.g = velocity + 0.5;
+	gl_FragColor = encode( height, velocity );
+}
+)GLSL";
+
+
+// the height differences in x and y direction of the displayed water state, biased by 0.5 into an RGBA8 normal map
+static const char * fragmentShaderSRC_waterNormal =
+R"GLSL(#version 100
+varying vec2 vTexCoord;
 
-	// height difference in x and y direction
-	tex.b = (rightHeight - leftHeight) + 0.5;
-	tex.a = (aboveHeight - belowHeight) + 0.5;
+uniform sampler2D uWaterTexture;
+uniform vec2 uWaterDeltaPixel;
 
-	gl_FragColor = tex;
+void main()
+{
+	vec2 dcx = vec2( uWaterDeltaPixel.x, 0.0 );
+	vec2 dcy = vec2( 0.0, uWaterDeltaPixel.y );
+	vec2 gradient = vec2(
+		decodeHeight( texture2D( uWaterTexture, vTexCoord + dcx ) ) - decodeHeight( texture2D( uWaterTexture, vTexCoord - dcx ) ),
+		decodeHeight( texture2D( uWaterTexture, vTexCoord + dcy ) ) - decodeHeight( texture2D( uWaterTexture, vTexCoord - dcy ) ) );
+	gl_FragColor = vec4( gradient + 0.5, 0.5, 0.5 );
 }
 )GLSL";
 
@@ -177,15 +301,15 @@ void main()
 
 static const char * fragmentShaderSRC_waterDrawer =
 R"GLSL(#version 100
-varying lowp vec2 vTexCoord;
+varying mediump vec2 vTexCoord;
 
-uniform sampler2D uWaterTexture;
+uniform sampler2D uNormalTexture;
 uniform sampler2D uBackgroundTexture;
 
 void main()
 {
-	lowp vec4 water = texture2D( uWaterTexture, vTexCoord );
-	lowp vec2 offset = vec2( water.b-0.5, water.a-0.5 ) * 0.04;
+	mediump vec2 gradient = texture2D( uNormalTexture, vTexCoord ).rg - 0.5;
+	mediump vec2 offset = gradient * 0.04;
 	lowp vec4 background = texture2D( uBackgroundTexture, vTexCoord + offset );
 	gl_FragColor = background;
 }
@@ -199,12 +323,9 @@ varying vec4 vColor;
 attribute vec2 aPosition;
 attribute vec4 aColor;
 
-uniform vec2 uPosition;
-uniform vec2 uScale;
-
 void main()
 {
-	gl_Position = vec4( (aPosition*uScale) + uPosition, 0.0, 1.0 );
+	gl_Position = vec4( aPosition, 0.0, 1.0 );
 	vColor = aColor;
 }
 )GLSL";
@@ -212,28 +333,100 @@ void main()
 
 static const char * fragmentShaderSRC_waterModulator =
 R"GLSL(#version 100
-varying lowp vec4 vColor;
+varying vec4 vColor; // unorm8 encoded
+
+void main()
+{
+	gl_FragColor = encode( vColor.r - 0.5, vColor.g - 0.5 );
+}
+)GLSL";
+
+
+// PointIR camera frames have their top row first
+static const char * vertexShaderSRC_camera =
+R"GLSL(#version 100
+varying vec2 vTexCoord;
+
+attribute vec2 aPosition;
+attribute vec2 aTexCoord;
+
+void main()
+{
+	gl_Position = vec4( aPosition, 0.0, 1.0 );
+	vTexCoord = vec2( aTexCoord.x, 1.0 - aTexCoord.y );
+}
+)GLSL";
+
+
+static const char * fragmentShaderSRC_camera =
+R"GLSL(#version 100
+varying lowp vec2 vTexCoord;
+
+uniform sampler2D uTexture;
+
+void main()
+{
+	gl_FragColor = vec4( texture2D( uTexture, vTexCoord ).rrr, 1.0 );
+}
+)GLSL";
+
+
+// pushes the water down under IR blobs, as deep as a touch at full intensity
+static const char * fragmentShaderSRC_waterCameraModulator =
+R"GLSL(#version 100
+varying mediump vec2 vTexCoord;
+
+uniform sampler2D uTexture;
+uniform mediump float uThreshold;
 
 void main()
 {
-	gl_FragColor = vColor;
+	mediump float intensity = texture2D( uTexture, vTexCoord ).r;
+	if( intensity < uThreshold )
+		discard;
+	gl_FragColor = encode( -0.5 * ( intensity - uThreshold ) / ( 1.0 - uThreshold ), 0.0 );
 }
 )GLSL";
 
 
-static const char * vertexShaderSRC_fish =
+// one instance per fish - the quad is translated, rotated and scaled like glm::translate * glm::rotate * glm::scale would do
+static const char * vertexShaderSRC_fishInstanced =
 R"GLSL(#version 100
 varying vec2 vTexCoord;
+varying float vPhase;
 
 attribute vec2 aPosition;
 attribute vec2 aTexCoord;
+attribute vec4 aInstance; // position, rotation, scale
+attribute float aPhase;
+
+void main()
+{
+	float c = cos( aInstance.z );
+	float s = sin( aInstance.z );
+	vec2 position = aPosition * aInstance.w;
+	gl_Position = vec4( c*position.x - s*position.y + aInstance.x, s*position.x + c*position.y + aInstance.y, 0.0, 1.0 );
+	vTexCoord = aTexCoord;
+	vPhase = aPhase;
+}
+)GLSL";
+
 
-uniform mat4 uMatrix;
+// fallback without instancing - the quads of all fish are transformed on the CPU
+static const char * vertexShaderSRC_fishBatched =
+R"GLSL(#version 100
+varying vec2 vTexCoord;
+varying float vPhase;
+
+attribute vec2 aPosition;
+attribute vec2 aTexCoord;
+attribute float aPhase;
 
 void main()
 {
-	gl_Position = uMatrix * vec4( aPosition, 0.0, 1.0 );
+	gl_Position = vec4( aPosition, 0.0, 1.0 );
 	vTexCoord = aTexCoord;
+	vPhase = aPhase;
 }
 )GLSL";
 
@@ -241,14 +434,15 @@ void main()
 static const char * fragmentShaderSRC_fish =
 R"GLSL(#version 100
 varying lowp vec2 vTexCoord;
+varying mediump float vPhase;
 
 uniform sampler2D uTexture;
-uniform lowp vec3 uPhaseFreqAmp;
+uniform lowp vec2 uFreqAmp;
 
 void main()
 {
 	lowp vec2 coord = vTexCoord;
-	coord.s += uPhaseFreqAmp.z * (1.0-coord.t)* (1.0-coord.t) * sin( uPhaseFreqAmp.x + coord.t * uPhaseFreqAmp.y );
+	coord.s += uFreqAmp.y * (1.0-coord.t)* (1.0-coord.t) * sin( vPhase + coord.t * uFreqAmp.x );
 	gl_FragColor = texture2D( uTexture, coord );
 }
 )GLSL";
@@ -275,34 +469,37 @@ struct VertexPC
 	float color[4];
 };
 
-static VertexPC centeredCirclePC[8];
+static VertexPC centeredCirclePC[8]; // drawn as a fan - the template every modulator circle is made of
 
+static std::vector< VertexPC > modulatorVerticesPC; // reused every frame by upload_waterModulators
 
-struct Touch
+
+struct VertexPTP
 {
-	float point[2];
-	uint8_t r;
-	uint8_t g;
-	uint8_t b;
+	float position[2];
+	float texCoord[2];
+	float phase;
 };
-std::map< int64_t, Touch > touches;
 
+static std::vector< VertexPTP > fishVerticesPTP; // reused every frame by the batched fish renderer
 
-struct Fish
+
+struct FishInstance
 {
-	float position[2] = { 0.0f, 0.0f };
-	float rotation = 0.0f;
-	float scale = 0.075f;
-	float phase = 0.0f;
-	float agility = 0.004f;
-	float speed = 0.0006f;
-	float maxSpeed = 0.005f;
-	float minSpeed = 0.0005f;
-	float rotationSpeed = 0.0f;
-	float rotationMaxSpeed = 0.1f;
-	float sensitivityDistance = 0.5f;
+	float position[2];
+	float rotation;
+	float scale;
+	float phase;
 };
-std::vector< Fish > fish;
+
+static std::vector< FishInstance > fishInstances; // reused every frame by the instanced fish renderer
+
+
+std::map< int64_t, Touch > touches;
+TouchGrid touchGrid;
+
+
+School fish;
 
 
 SDL_Window * window = nullptr;
@@ -311,14 +508,31 @@ SDL_GLContext glContext = nullptr;
 Program program_waterDrawer;
 GLint program_waterDrawer_aPosition;
 GLint program_waterDrawer_aTexCoord;
-GLint program_waterDrawer_uWaterTexture;
+GLint program_waterDrawer_uNormalTexture;
 GLint program_waterDrawer_uBackgroundTexture;
 
+Program program_waterNormal;
+GLint program_waterNormal_aPosition;
+GLint program_waterNormal_aTexCoord;
+GLint program_waterNormal_uWaterTexture;
+GLint program_waterNormal_uWaterDeltaPixel;
+
 Program program_waterModulator;
 GLint program_waterModulator_aPosition;
 GLint program_waterModulator_aColor;
-GLint program_waterModulator_uPosition;
-GLint program_waterModulator_uScale;
+
+Program program_camera;
+GLint program_camera_aPosition;
+GLint program_camera_aTexCoord;
+GLint program_camera_uTexture;
+
+Program program_waterCameraModulator;
+GLint program_waterCameraModulator_aPosition;
+GLint program_waterCameraModulator_aTexCoord;
+GLint program_waterCameraModulator_uTexture;
+GLint program_waterCameraModulator_uThreshold;
+
+const float cameraThreshold = 0.5f; // IR blobs are bright, the rest of the camera image is dark
 
 Program program_water;
 GLint program_water_aPosition;
@@ -331,59 +545,120 @@ GLint program_copy_aPosition;
 GLint program_copy_aTexCoord;
 GLint program_copy_uTexture;
 
-Program program_fish;
-GLint program_fish_aPosition;
-GLint program_fish_aTexCoord;
-GLint program_fish_uTexture;
-GLint program_fish_uMatrix;
-GLint program_fish_uPhaseFreqAmp;
+Program program_fishInstanced;
+GLint program_fishInstanced_aPosition;
+GLint program_fishInstanced_aTexCoord;
+GLint program_fishInstanced_aInstance;
+GLint program_fishInstanced_aPhase;
+GLint program_fishInstanced_uTexture;
+GLint program_fishInstanced_uFreqAmp;
+
+Program program_fishBatched;
+GLint program_fishBatched_aPosition;
+GLint program_fishBatched_aTexCoord;
+GLint program_fishBatched_aPhase;
+GLint program_fishBatched_uTexture;
+GLint program_fishBatched_uFreqAmp;
+
+// GL_EXT_instanced_arrays or GL_ANGLE_instanced_arrays - null if not available
+PFNGLDRAWARRAYSINSTANCEDEXTPROC drawArraysInstanced = nullptr;
+PFNGLVERTEXATTRIBDIVISOREXTPROC vertexAttribDivisor = nullptr;
 
 GLuint vertexBufferCenteredQuadPT;
-GLuint vertexBufferCenteredCirclePC;
+// all modulators of a frame - while the GPU may still read one buffer, the next frame writes the other
+GLuint vertexBuffersModulator[2];
+size_t vertexBuffersModulatorSize[2] = { 0, 0 };
+unsigned int vertexBufferModulatorCurrent = 0;
+unsigned int modulatorCircles = 0;
+GLuint indexBufferModulator; // the fans of centeredCirclePC as triangles
+unsigned int indexBufferModulatorCircles = 0;
+GLuint vertexBufferFish; // streamed every frame
 
 FrameBuffer2D * waterFrameBufferSrc = nullptr;
 FrameBuffer2D * waterFrameBufferDst = nullptr;
-FrameBuffer2D * backgroundFrameBuffer = nullptr;
+FrameBuffer2D * waterNormalFrameBuffer = nullptr; // written by render_waterNormal once per displayed frame
+FrameBuffer2D * backgroundFrameBuffer = nullptr; // the background with the fish on top at the size of the viewport - null without fish
+FrameBuffer2D * screenFrameBuffer = nullptr; // replaces the default framebuffer when running headless
 
 Texture2D * backgroundTexture = nullptr;
 Texture2D * fishTexture = nullptr;
 
+ImageLoader * imageLoader = nullptr; // owns DevIL after initialisation
+AssetPack * assetPack = nullptr;
+
+ThreadPool * threadPool = nullptr; // shared by the fish and the CPU water simulator - only one of them may use it at a time
+Random rng; // seeded from the command line - everything random must come from here or from a Random of its own
+WaterSimulator * waterSimulator = nullptr; // simulates the water on the CPU instead of render_water if set
+Texture2D * waterTexture = nullptr; // receives the state of waterSimulator
+DirtyRegion * waterDirtyRegion = nullptr; // the water outside is calm and not simulated
+
+
+// linear minification, with mipmaps if GLES2 supports them for the size of the image
+GLint image_minFilter( const Image & image )
+{
+	return Texture2D::canMipmap( image.getWidth(), image.getHeight() ) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+}
+
 
 float randf()
 {
-	return (float)rand() / (float)RAND_MAX;
+	return rng.nextFloat();
 }
 
 
-void render_water( const Texture2D * sourceTexture, unsigned int width, unsigned int height )
+// sets up everything render_water_step needs - stays valid until other programs or buffers are used
+void render_water_prepare( unsigned int width, unsigned int height )
 {
 	program_water.use();
 	glUniform2f( program_water_uDeltaPixel, 1.0/width, 1.0/height );
 	glUniform1i( program_water_uTexture, 0 );
-	sourceTexture->bind( 0 );
+	GLState::activeTexture( 0 );
+
+	GLState::vertexAttribPointer( program_water_aPosition, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,position) );
+	GLState::vertexAttribPointer( program_water_aTexCoord, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,texCoord) );
+	GLState::enableVertexAttribArrays( 1u << program_water_aPosition | 1u << program_water_aTexCoord );
+}
+
+
+void render_water_step( const Texture2D * sourceTexture )
+{
+	sourceTexture->bind();
+	glDrawArrays( GL_TRIANGLE_STRIP, 0, sizeof(centeredQuadPT)/sizeof(VertexPT) );
+}
 
-	glBindBuffer( GL_ARRAY_BUFFER, vertexBufferCenteredQuadPT );
-	glVertexAttribPointer( program_water_aPosition, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), (void*)offsetof(VertexPT,position) );
-	glVertexAttribPointer( program_water_aTexCoord, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), (void*)offsetof(VertexPT,texCoord) );
-	glEnableVertexAttribArray( program_water_aPosition );
-	glEnableVertexAttribArray( program_water_aTexCoord );
+
+void render_water( const Texture2D * sourceTexture, unsigned int width, unsigned int height )
+{
+	render_water_prepare( width, height );
+	render_water_step( sourceTexture );
+}
+
+
+void render_waterNormal( const Texture2D * waterTexture )
+{
+	program_waterNormal.use();
+	glUniform1i( program_waterNormal_uWaterTexture, 0 );
+	glUniform2f( program_waterNormal_uWaterDeltaPixel, 1.0/waterTexture->getWidth(), 1.0/waterTexture->getHeight() );
+	waterTexture->bind( 0 );
+
+	GLState::vertexAttribPointer( program_waterNormal_aPosition, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,position) );
+	GLState::vertexAttribPointer( program_waterNormal_aTexCoord, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,texCoord) );
+	GLState::enableVertexAttribArrays( 1u << program_waterNormal_aPosition | 1u << program_waterNormal_aTexCoord );
 	glDrawArrays( GL_TRIANGLE_STRIP, 0, sizeof(centeredQuadPT)/sizeof(VertexPT) );
 }
 
 
-void render_waterDrawer( const Texture2D * waterTexture, const Texture2D * backgroundTexture )
+void render_waterDrawer( const Texture2D * normalTexture, const Texture2D * backgroundTexture )
 {
 	program_waterDrawer.use();
 	glUniform1i( program_waterDrawer_uBackgroundTexture, 1);
 	backgroundTexture->bind( 1 );
-	glUniform1i( program_waterDrawer_uWaterTexture, 0 );
-	waterTexture->bind( 0 );
+	glUniform1i( program_waterDrawer_uNormalTexture, 0 );
+	normalTexture->bind( 0 );
 
-	glBindBuffer( GL_ARRAY_BUFFER, vertexBufferCenteredQuadPT );
-	glVertexAttribPointer( program_waterDrawer_aPosition, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), (void*)offsetof(VertexPT,position) );
-	glVertexAttribPointer( program_waterDrawer_aTexCoord, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), (void*)offsetof(VertexPT,texCoord) );
-	glEnableVertexAttribArray( program_waterDrawer_aPosition );
-	glEnableVertexAttribArray( program_waterDrawer_aTexCoord );
+	GLState::vertexAttribPointer( program_waterDrawer_aPosition, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,position) );
+	GLState::vertexAttribPointer( program_waterDrawer_aTexCoord, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,texCoord) );
+	GLState::enableVertexAttribArrays( 1u << program_waterDrawer_aPosition | 1u << program_waterDrawer_aTexCoord );
 	glDrawArrays( GL_TRIANGLE_STRIP, 0, sizeof(centeredQuadPT)/sizeof(VertexPT) );
 }
 
@@ -394,197 +669,1036 @@ void render_copy( const Texture2D * texture )
 	glUniform1i( program_copy_uTexture, 0 );
 	texture->bind( 0 );
 
-	glBindBuffer( GL_ARRAY_BUFFER, vertexBufferCenteredQuadPT );
-	glVertexAttribPointer( program_copy_aPosition, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), (void*)offsetof(VertexPT,position) );
-	glVertexAttribPointer( program_copy_aTexCoord, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), (void*)offsetof(VertexPT,texCoord) );
-	glEnableVertexAttribArray( program_copy_aPosition );
-	glEnableVertexAttribArray( program_copy_aTexCoord );
+	GLState::vertexAttribPointer( program_copy_aPosition, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,position) );
+	GLState::vertexAttribPointer( program_copy_aTexCoord, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,texCoord) );
+	GLState::enableVertexAttribArrays( 1u << program_copy_aPosition | 1u << program_copy_aTexCoord );
 	glDrawArrays( GL_TRIANGLE_STRIP, 0, sizeof(centeredQuadPT)/sizeof(VertexPT) );
 }
 
 
-void render_waterModulator( const float position[2], float scale )
+// places a circle at every touch - the touches do not change during a frame, so all substeps draw the same
+void upload_waterModulators( const std::map< int64_t, Touch > & touches, float scale )
+{
+	const unsigned int circleVertices = sizeof(centeredCirclePC)/sizeof(VertexPC);
+	// 16 bit indices
+	const unsigned int maxCircles = 65536 / circleVertices;
+
+	modulatorCircles = std::min( (unsigned int)touches.size(), maxCircles );
+	if( !modulatorCircles )
+		return;
+
+	if( modulatorCircles > indexBufferModulatorCircles )
+	{
+		std::vector< GLushort > indices;
+		indices.reserve( modulatorCircles * (circleVertices-2) * 3 );
+		for( unsigned int circle = 0; circle < modulatorCircles; circle++ )
+		{
+			GLushort first = circle * circleVertices;
+			for( unsigned int i = 1; i+1 < circleVertices; i++ )
+			{
+				indices.push_back( first );
+				indices.push_back( first + i );
+				indices.push_back( first + i + 1 );
+			}
+		}
+		GLState::bindElementBuffer( indexBufferModulator );
+		glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW );
+		indexBufferModulatorCircles = modulatorCircles;
+	}
+
+	modulatorVerticesPC.resize( modulatorCircles * circleVertices );
+	VertexPC * vertex = modulatorVerticesPC.data();
+	unsigned int circle = 0;
+	for( const auto & t : touches )
+	{
+		if( circle++ == modulatorCircles )
+			break;
+		for( const VertexPC & v : centeredCirclePC )
+		{
+			vertex->position[0] = v.position[0] * scale + t.second.point[0];
+			vertex->position[1] = v.position[1] * scale + t.second.point[1];
+			std::copy( v.color, v.color + 4, vertex->color );
+			vertex++;
+		}
+	}
+
+	vertexBufferModulatorCurrent ^= 1;
+	GLState::bindBuffer( vertexBuffersModulator[vertexBufferModulatorCurrent] );
+	size_t size = modulatorVerticesPC.size() * sizeof(VertexPC);
+	if( size > vertexBuffersModulatorSize[vertexBufferModulatorCurrent] )
+	{
+		glBufferData( GL_ARRAY_BUFFER, size, modulatorVerticesPC.data(), GL_DYNAMIC_DRAW );
+		vertexBuffersModulatorSize[vertexBufferModulatorCurrent] = size;
+	}
+	else
+	{
+		glBufferSubData( GL_ARRAY_BUFFER, 0, size, modulatorVerticesPC.data() );
+	}
+}
+
+
+void render_waterModulators()
 {
+	if( !modulatorCircles )
+		return;
+
 	program_waterModulator.use();
-	glUniform2fv( program_waterModulator_uPosition, 1, position );
-	glUniform2f( program_waterModulator_uScale, scale, scale );
 
-	glBindBuffer( GL_ARRAY_BUFFER, vertexBufferCenteredCirclePC );
-	glVertexAttribPointer( program_waterModulator_aPosition, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPC), (void*)offsetof(VertexPC,position) );
-	glVertexAttribPointer( program_waterModulator_aColor, 4, GL_FLOAT, GL_FALSE, sizeof(VertexPC), (void*)offsetof(VertexPC,color) );
-	glEnableVertexAttribArray( program_waterModulator_aPosition );
-	glEnableVertexAttribArray( program_waterModulator_aColor );
-	glDrawArrays( GL_TRIANGLE_FAN, 0, sizeof(centeredCirclePC)/sizeof(VertexPC) );
+	GLuint buffer = vertexBuffersModulator[vertexBufferModulatorCurrent];
+	GLState::vertexAttribPointer( program_waterModulator_aPosition, buffer, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPC), offsetof(VertexPC,position) );
+	GLState::vertexAttribPointer( program_waterModulator_aColor, buffer, 4, GL_FLOAT, GL_FALSE, sizeof(VertexPC), offsetof(VertexPC,color) );
+	GLState::enableVertexAttribArrays( 1u << program_waterModulator_aPosition | 1u << program_waterModulator_aColor );
+	GLState::bindElementBuffer( indexBufferModulator );
+	glDrawElements( GL_TRIANGLES, modulatorCircles * (sizeof(centeredCirclePC)/sizeof(VertexPC)-2) * 3, GL_UNSIGNED_SHORT, 0 );
 }
 
 
-void render_fish( const std::vector<Fish> & fish )
+void render_camera( const Texture2D * texture )
 {
-	static float freq = 4.0f;
+	program_camera.use();
+	glUniform1i( program_camera_uTexture, 0 );
+	texture->bind( 0 );
 
-	static float amp = 0.2f;
+	GLState::vertexAttribPointer( program_camera_aPosition, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,position) );
+	GLState::vertexAttribPointer( program_camera_aTexCoord, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,texCoord) );
+	GLState::enableVertexAttribArrays( 1u << program_camera_aPosition | 1u << program_camera_aTexCoord );
+	glDrawArrays( GL_TRIANGLE_STRIP, 0, sizeof(centeredQuadPT)/sizeof(VertexPT) );
+}
 
-	glEnable( GL_BLEND );
-	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 
-	program_fish.use();
-	glUniform1i( program_fish_uTexture, 0 );
-	fishTexture->bind( 0 );
+// the camera frame is stretched over the whole water - like the touches, it overwrites the water where it is bright
+void render_waterCameraModulator( const Texture2D * texture )
+{
+	program_waterCameraModulator.use();
+	glUniform1i( program_waterCameraModulator_uTexture, 0 );
+	glUniform1f( program_waterCameraModulator_uThreshold, cameraThreshold );
+	texture->bind( 0 );
 
+	GLState::vertexAttribPointer( program_waterCameraModulator_aPosition, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,position) );
+	GLState::vertexAttribPointer( program_waterCameraModulator_aTexCoord, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,texCoord) );
+	GLState::enableVertexAttribArrays( 1u << program_waterCameraModulator_aPosition | 1u << program_waterCameraModulator_aTexCoord );
+	glDrawArrays( GL_TRIANGLE_STRIP, 0, sizeof(centeredQuadPT)/sizeof(VertexPT) );
+}
 
-	glBindBuffer( GL_ARRAY_BUFFER, vertexBufferCenteredQuadPT );
-	glVertexAttribPointer( program_fish_aPosition, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), (void*)offsetof(VertexPT,position) );
-	glVertexAttribPointer( program_fish_aTexCoord, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), (void*)offsetof(VertexPT,texCoord) );
-	glEnableVertexAttribArray( program_fish_aPosition );
-	glEnableVertexAttribArray( program_fish_aTexCoord );
 
-	for( const auto & f : fish )
+// the bounding box of all pixels above cameraThreshold, in the coordinates of the touches - false if there are none
+bool camera_findBlobs( const uint8_t * pixels, unsigned int width, unsigned int height, float position[2], float & radius )
+{
+	const uint8_t threshold = (uint8_t)std::ceil( cameraThreshold * 255.0f );
+	int xMin = width, xMax = -1, yMin = height, yMax = -1;
+	for( unsigned int y = 0; y < height; y++ )
 	{
-		glm::mat4 matrix;
-		matrix = glm::translate( matrix, glm::vec3(f.position[0],f.position[1],0.0f) );
-		matrix = glm::rotate( matrix, f.rotation, glm::vec3(0.0f,0.0f,1.0f) );
-		matrix = glm::scale( matrix, glm::vec3(f.scale,f.scale,f.scale) );
+		const uint8_t * row = pixels + y * width;
+		for( unsigned int x = 0; x < width; x++ )
+		{
+			if( row[x] < threshold )
+				continue;
+			xMin = std::min( xMin, (int)x );
+			xMax = std::max( xMax, (int)x );
+			yMin = std::min( yMin, (int)y );
+			yMax = std::max( yMax, (int)y );
+		}
+	}
+	if( xMax < 0 )
+		return false;
+
+	// the rows are top first, the touches have y up
+	float x0 = xMin * 2.0f / width - 1.0f, x1 = ( xMax + 1 ) * 2.0f / width - 1.0f;
+	float y0 = 1.0f - ( yMax + 1 ) * 2.0f / height, y1 = 1.0f - yMin * 2.0f / height;
+	position[0] = 0.5f * ( x0 + x1 );
+	position[1] = 0.5f * ( y0 + y1 );
+	radius = 0.5f * std::max( x1 - x0, y1 - y0 );
+	return true;
+}
 
-		glUniform3f( program_fish_uPhaseFreqAmp, f.phase, freq, amp );
-		glUniformMatrix4fv( program_fish_uMatrix, 1, false, glm::value_ptr(matrix) );
 
-		glDrawArrays( GL_TRIANGLE_STRIP, 0, sizeof(centeredQuadPT)/sizeof(VertexPT) );
+void render_fish_instanced( const School & fish, float freq, float amp )
+{
+	fishInstances.resize( fish.size() );
+	for( unsigned int i = 0; i < fish.size(); i++ )
+	{
+		FishInstance & instance = fishInstances[i];
+		instance.position[0] = fish.getPositionX()[i];
+		instance.position[1] = fish.getPositionY()[i];
+		instance.rotation = fish.getRotation()[i];
+		instance.scale = fish.getScale()[i];
+		// the phase grows forever - keep it small enough for mediump
+		instance.phase = std::fmod( fish.getPhase()[i], (float)(2.0*PI) );
 	}
 
-	glDisable( GL_BLEND );
+	program_fishInstanced.use();
+	glUniform1i( program_fishInstanced_uTexture, 0 );
+	glUniform2f( program_fishInstanced_uFreqAmp, freq, amp );
+	fishTexture->bind( 0 );
+
+	GLState::bindBuffer( vertexBufferFish );
+	glBufferData( GL_ARRAY_BUFFER, fishInstances.size() * sizeof(FishInstance), fishInstances.data(), GL_STREAM_DRAW );
+
+	GLState::vertexAttribPointer( program_fishInstanced_aPosition, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,position) );
+	GLState::vertexAttribPointer( program_fishInstanced_aTexCoord, vertexBufferCenteredQuadPT, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPT), offsetof(VertexPT,texCoord) );
+	GLState::vertexAttribPointer( program_fishInstanced_aInstance, vertexBufferFish, 4, GL_FLOAT, GL_FALSE, sizeof(FishInstance), offsetof(FishInstance,position) );
+	GLState::vertexAttribPointer( program_fishInstanced_aPhase, vertexBufferFish, 1, GL_FLOAT, GL_FALSE, sizeof(FishInstance), offsetof(FishInstance,phase) );
+	uint32_t instanced = 1u << program_fishInstanced_aInstance | 1u << program_fishInstanced_aPhase;
+	GLState::enableVertexAttribArrays( 1u << program_fishInstanced_aPosition | 1u << program_fishInstanced_aTexCoord | instanced, instanced );
+
+	drawArraysInstanced( GL_TRIANGLE_STRIP, 0, sizeof(centeredQuadPT)/sizeof(VertexPT), fish.size() );
 }
 
 
-void update_fish( std::vector<Fish> & fish, const std::map< int64_t, Touch > & touches )
+void render_fish_batched( const School & fish, float freq, float amp )
 {
-	for( auto & f : fish )
+	// two triangles per fish, in the same order as the strip of centeredQuadPT
+	static const unsigned int corners[6] = { 0, 1, 2, 2, 1, 3 };
+
+	fishVerticesPTP.resize( fish.size() * 6 );
+	VertexPTP * vertex = fishVerticesPTP.data();
+	for( unsigned int i = 0; i < fish.size(); i++ )
 	{
-		float nearestDistance = std::numeric_limits< float >::max();
-		const Touch * nearest = nullptr;
-		for( const auto & t : touches )
+		float x = fish.getPositionX()[i];
+		float y = fish.getPositionY()[i];
+		float c = std::cos( fish.getRotation()[i] ) * fish.getScale()[i];
+		float s = std::sin( fish.getRotation()[i] ) * fish.getScale()[i];
+		float phase = std::fmod( fish.getPhase()[i], (float)(2.0*PI) );
+		for( unsigned int corner : corners )
 		{
-			float dx = t.second.point[0] - f.position[0];
-			float dy = t.second.point[1] - f.position[1];
-			float distance = dx*dx + dy*dy;
-			if( distance < nearestDistance && distance < f.sensitivityDistance )
-			{
-				nearestDistance = distance;
-				nearest = &t.second;
-			}
+			const VertexPT & quad = centeredQuadPT[corner];
+			vertex->position[0] = c*quad.position[0] - s*quad.position[1] + x;
+			vertex->position[1] = s*quad.position[0] + c*quad.position[1] + y;
+			vertex->texCoord[0] = quad.texCoord[0];
+			vertex->texCoord[1] = quad.texCoord[1];
+			vertex->phase = phase;
+			vertex++;
 		}
+	}
 
-		glm::vec2 perp( cos(f.rotation), sin(f.rotation) );
-		glm::vec2 head( cos(f.rotation+PI/2.0f), sin(f.rotation+PI/2.0f) );
-		glm::vec2 toCenter( -f.position[0], -f.position[1] );
-		toCenter = glm::normalize( toCenter );
+	program_fishBatched.use();
+	glUniform1i( program_fishBatched_uTexture, 0 );
+	glUniform2f( program_fishBatched_uFreqAmp, freq, amp );
+	fishTexture->bind( 0 );
 
-		if( nearest )
-		{
-			float diff = f.maxSpeed - f.speed;
-			f.speed += f.agility * diff;
+	GLState::bindBuffer( vertexBufferFish );
+	glBufferData( GL_ARRAY_BUFFER, fishVerticesPTP.size() * sizeof(VertexPTP), fishVerticesPTP.data(), GL_STREAM_DRAW );
+	GLState::vertexAttribPointer( program_fishBatched_aPosition, vertexBufferFish, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPTP), offsetof(VertexPTP,position) );
+	GLState::vertexAttribPointer( program_fishBatched_aTexCoord, vertexBufferFish, 2, GL_FLOAT, GL_FALSE, sizeof(VertexPTP), offsetof(VertexPTP,texCoord) );
+	GLState::vertexAttribPointer( program_fishBatched_aPhase, vertexBufferFish, 1, GL_FLOAT, GL_FALSE, sizeof(VertexPTP), offsetof(VertexPTP,phase) );
+	GLState::enableVertexAttribArrays( 1u << program_fishBatched_aPosition | 1u << program_fishBatched_aTexCoord | 1u << program_fishBatched_aPhase );
 
-			glm::vec2 toTouch( nearest->point[0] - f.position[0], nearest->point[1] - f.position[1] );
-			toTouch = glm::normalize( toTouch );
-			float dot = glm::dot( perp, toTouch );
-			f.rotationSpeed -= f.agility * dot;
+	glDrawArrays( GL_TRIANGLES, 0, fishVerticesPTP.size() );
+}
 
-		}
-		else
-		{
-			float diff = f.speed - f.minSpeed;
-			f.speed -= f.agility * diff;
 
-			float dot = glm::dot( perp, toCenter );
-			f.rotationSpeed -= 0.1f * f.agility * dot;
-		}
+void render_fish( const School & fish )
+{
+	static float freq = 4.0f;
 
-		if( f.rotationSpeed > f.rotationMaxSpeed )
-			f.rotationSpeed = f.rotationMaxSpeed;
-		else if( f.rotationSpeed < -f.rotationMaxSpeed )
-			f.rotationSpeed = -f.rotationMaxSpeed;
+	static float amp = 0.2f;
 
-		f.phase += 5.0f * ((f.speed)/f.scale);
-		f.position[0] += head.x * f.speed;
-		f.position[1] += head.y * f.speed;
-		f.rotation += f.rotationSpeed;
-		f.rotationSpeed -= 10.0f * f.agility * f.rotationSpeed;
-	}
-}
+	if( fish.empty() )
+		return;
 
+	GLState::setBlend( true );
+	GLState::blendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 
-#ifdef GLESPOND_POINTIR
-void calibrate()
-{
-	int w = 0, h = 0;
-	SDL_GetWindowSize( window, &w, &h );
+	if( drawArraysInstanced )
+		render_fish_instanced( fish, freq, amp );
+	else
+		render_fish_batched( fish, freq, amp );
 
-	Texture2D calibrationTexture( dbus.getCalibrationImageFile( w, h ) );
+	GLState::setBlend( false );
+}
 
-	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
-	glViewport( 0, 0, w, h );
-	render_copy( &calibrationTexture );
-	SDL_GL_SwapWindow( window );
 
-	dbus.calibrate();
+const Touch * find_nearestTouch( const Fish & f, const std::map< int64_t, Touch > & touches )
+{
+	float nearestDistance = std::numeric_limits< float >::max();
+	const Touch * nearest = nullptr;
+	for( const auto & t : touches )
+	{
+		float dx = t.second.point[0] - f.position[0];
+		float dy = t.second.point[1] - f.position[1];
+		float distance = dx*dx + dy*dy;
+		if( distance < nearestDistance && distance < f.sensitivityDistance )
+		{
+			nearestDistance = distance;
+			nearest = &t.second;
+		}
+	}
+	return nearest;
 }
-#endif
 
 
-struct arguments
+void update_fish( School & fish, const TouchGrid & touchGrid )
 {
-	std::string backgroundImageFile;
-	std::string fishTexture;
-	unsigned int waterResolutionDivider = 4;
-	unsigned int numberOfFish = 0;
-};
+	fish.update( touchGrid, threadPool );
+}
 
 
-void print_usage( int argc, char ** argv )
+// lets the thread pool update the fish while the caller does something else - until update_fish_wait
+void update_fish_start( School & fish, const TouchGrid & touchGrid )
 {
-	printf
-	(
-		"Usage: %s [--waterResolutionDivider=int] [--numberOfFish=int] [--fishTexture=string] <background image file>\n",
-		argv[0]
-	);
+	threadPool->start( fish.getChunkCount(), [&fish,&touchGrid]( unsigned int chunk )
+	{
+		fish.updateChunk( touchGrid, chunk );
+	} );
 }
 
 
-int main( int argc, char ** argv )
+void update_fish_wait()
 {
-	////////////////////////////////
-	// argument parsing
-	struct arguments arguments;
+	threadPool->wait();
+}
 
-	static struct option long_options[] =
-	{
-		{ "waterResolutionDivider", required_argument, 0, 'd' },
-		{ "numberOfFish",           required_argument, 0, 'f' },
-		{ "fishTexture",            required_argument, 0, 't' },
-		{ 0,           0,                              0, 0   }
-	};
 
-	int opt = 0;
-	int option_index = 0;
-	while( ( opt = getopt_long( argc, argv, "d:f:t:", long_options, &option_index ) ) != -1 )
+bool verify_waterSimulator( WaterSimulator::Kernel kernel, unsigned int width, unsigned int height, unsigned int steps )
+{
+	WaterSimulator simulator( width, height, kernel );
+	Texture2D input( width, height, GL_RGBA, GL_NEAREST, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE );
+	FrameBuffer2D output( width, height, GL_RGBA );
+	std::vector< uint8_t > reference( 4*width*height );
+	std::vector< uint8_t > shader( 4*width*height );
+
+	unsigned long kernelMismatches = 0;
+	unsigned long shaderMismatches = 0;
+	unsigned int shaderMaxDifference = 0;
+	for( unsigned int i = 0; i < steps; i++ )
 	{
-		switch( opt )
+		// drop a stone now and then, so there is always something moving
+		if( i % 32 == 0 )
 		{
-		case 'd':
-			arguments.waterResolutionDivider = strtoul( optarg, NULL, 10 );
-			break;
-		case 'f':
-			arguments.numberOfFish = strtoul( optarg, NULL, 10 );
-			break;
-		case 't':
-			arguments.fishTexture = optarg;
-			break;
-		default:
-			print_usage( argc, argv );
-			return EXIT_FAILURE;
+			float position[2] = { randf() * 2.0f - 1.0f, randf() * 2.0f - 1.0f };
+			simulator.disturb( position, 0.03f );
 		}
-	}
 
-	if( optind+1 != argc )
+		// both sides start every step from the same state, so differences do not build up
+		input.upload( simulator.getData() );
+		output.bind();
+		render_water( &input, width, height );
+		output.readPixels( shader.data() );
+
+		WaterSimulator::step( WaterSimulator::Kernel::Scalar, simulator.getData(), reference.data(), width, height, 0, height );
+		simulator.step();
+
+		const uint8_t * data = simulator.getData();
+		for( size_t j = 0; j < reference.size(); j++ )
+		{
+			if( data[j] != reference[j] )
+				kernelMismatches++;
+			unsigned int difference = std::abs( (int)data[j] - (int)shader[j] );
+			if( difference )
+				shaderMismatches++;
+			shaderMaxDifference = std::max( shaderMaxDifference, difference );
+		}
+	}
+
+	// the shader runs at lowp - its rounding may differ by one step
+	bool passed = !kernelMismatches && shaderMaxDifference <= 1;
+
+	std::cout << "Water simulator verification (" << WaterSimulator::getName( simulator.getKernel() ) << ", " << width << "x" << height << ", " << steps << " steps)\n";
+	std::cout << "  Bytes differing from scalar kernel : " << kernelMismatches << "\n";
+	std::cout << "  Bytes differing from shader        : " << shaderMismatches << " of " << (unsigned long)reference.size() * steps << "\n";
+	std::cout << "  Maximum difference to shader       : " << shaderMaxDifference << "\n";
+	std::cout << "  " << ( passed ? "PASSED" : "FAILED" ) << "\n";
+
+	return passed;
+}
+
+
+void benchmark_waterSimulator( WaterSimulator::Kernel kernel, unsigned int width, unsigned int height, unsigned int steps, unsigned int maxThreads )
+{
+	double singleThreadSeconds = 0.0;
+	for( unsigned int threads = 1; threads <= maxThreads; threads++ )
+	{
+		ThreadPool pool( threads );
+		WaterSimulator simulator( width, height, kernel, &pool );
+		if( threads == 1 )
+		{
+			std::cout << "Water simulator scaling (" << WaterSimulator::getName( simulator.getKernel() ) << ", " << width << "x" << height << ", "
+			          << simulator.getTileRows() << " rows per tile, " << steps << " steps)\n";
+			printf( "  Threads   ms/step  MPixel/s   Speedup\n" );
+		}
+
+		float position[2] = { 0.0f, 0.0f };
+		simulator.disturb( position, 0.1f );
+		simulator.step(); // warm up the threads and caches
+
+		auto begin = std::chrono::steady_clock::now();
+		for( unsigned int i = 0; i < steps; i++ )
+			simulator.step();
+		double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - begin ).count();
+		if( threads == 1 )
+			singleThreadSeconds = seconds;
+
+		printf( "  %7u %9.3f %9.1f %9.2f\n", threads, seconds * 1000.0 / steps, (double)width * height * steps / seconds / 1e6, singleThreadSeconds / seconds );
+	}
+}
+
+
+void benchmark_touchGrid( unsigned int numberOfTouches, unsigned int iterations )
+{
+	std::map< int64_t, Touch > touches;
+	for( unsigned int i = 0; i < numberOfTouches; i++ )
+	{
+		Touch t;
+		t.point[0] = randf() * 2.0f - 1.0f;
+		t.point[1] = randf() * 2.0f - 1.0f;
+		t.r = t.g = t.b = 255;
+		touches[i] = t;
+	}
+	TouchGrid grid;
+
+	std::cout << "Nearest touch queries (" << numberOfTouches << " touches, " << iterations << " iterations)\n";
+	printf( "     Fish   scan ms   grid ms   Speedup  Mismatches\n" );
+	for( unsigned int numberOfFish : { 10u, 100u, 10000u } )
+	{
+		std::vector< Fish > fish( numberOfFish );
+		for( auto & f : fish )
+		{
+			f.position[0] = randf() * 2.0f - 1.0f;
+			f.position[1] = randf() * 2.0f - 1.0f;
+			f.sensitivityDistance = randf() * 0.4f + 0.1f;
+		}
+
+		std::vector< const Touch * > scanResults( numberOfFish );
+		std::vector< const Touch * > gridResults( numberOfFish );
+
+		auto begin = std::chrono::steady_clock::now();
+		for( unsigned int i = 0; i < iterations; i++ )
+			for( unsigned int j = 0; j < numberOfFish; j++ )
+				scanResults[j] = find_nearestTouch( fish[j], touches );
+		double scanSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - begin ).count();
+
+		// the grid is rebuilt every frame, so that is part of the measurement
+		begin = std::chrono::steady_clock::now();
+		for( unsigned int i = 0; i < iterations; i++ )
+		{
+			grid.rebuild( touches );
+			for( unsigned int j = 0; j < numberOfFish; j++ )
+				gridResults[j] = grid.findNearest( fish[j].position[0], fish[j].position[1], fish[j].sensitivityDistance );
+		}
+		double gridSeconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - begin ).count();
+
+		unsigned int mismatches = 0;
+		for( unsigned int j = 0; j < numberOfFish; j++ )
+			if( scanResults[j] != gridResults[j] )
+				mismatches++;
+
+		printf( "  %7u %9.3f %9.3f %9.2f %11u\n", numberOfFish, scanSeconds * 1000.0 / iterations, gridSeconds * 1000.0 / iterations, scanSeconds / gridSeconds, mismatches );
+	}
+}
+
+
+#ifdef GLESPOND_POINTIR
+// the pond keeps running while the daemon works - only the camera needs to see the calibration image
+enum class Calibration
+{
+	Idle,
+	RequestingImage, // the daemon generates the image
+	LoadingImage,    // the image loader decodes it, unless the daemon shared the pixels
+	ShowingImage,    // the next frame shows it
+	Calibrating      // the daemon looks at it
+};
+static Calibration calibration = Calibration::Idle;
+static unsigned int calibrationTicket = 0;
+static Texture2D * calibrationTexture = nullptr;
+
+
+void calibrate()
+{
+	if( calibration != Calibration::Idle )
+		return;
+	int w = 0, h = 0;
+	SDL_GetWindowSize( window, &w, &h );
+	if( pointIR->requestCalibrationImage( w, h ) )
+		calibration = Calibration::RequestingImage;
+	else
+		std::cerr << "PointIR is busy - calibration not started\n";
+}
+
+
+void calibrate_stop()
+{
+	if( calibration == Calibration::LoadingImage )
+		imageLoader->cancel( calibrationTicket );
+	delete calibrationTexture;
+	calibrationTexture = nullptr;
+	calibration = Calibration::Idle;
+}
+
+
+// uploads the pixels the daemon shared - takes the file descriptor
+Texture2D * calibrate_mapImage( int fd, unsigned int width, unsigned int height )
+{
+	size_t size = (size_t)width * height * 4;
+	struct stat status;
+	if( fstat( fd, &status ) || (size_t)status.st_size < size || !size )
+	{
+		close( fd );
+		throw RUNTIME_ERROR( "Shared calibration image does not hold " + std::to_string( width ) + "x" + std::to_string( height ) + " RGBA pixels" );
+	}
+	void * pixels = mmap( nullptr, size, PROT_READ, MAP_SHARED, fd, 0 );
+	int error = errno;
+	close( fd );
+	if( pixels == MAP_FAILED )
+		throw SYSTEM_ERROR( error, "Could not map the shared calibration image" );
+
+	Texture2D * texture = nullptr;
+	try
+	{
+		Image image( "PointIR calibration image", width, height, GL_RGBA, GL_UNSIGNED_BYTE, false, (const uint8_t *)pixels, size, std::vector< size_t >() );
+		texture = new Texture2D( image );
+	}
+	catch( ... )
+	{
+		munmap( pixels, size );
+		throw;
+	}
+	munmap( pixels, size );
+	return texture;
+}
+
+
+// advances calibrate() with the replies of the daemon and the image loader - returns true if the screen changes
+bool calibrate_update()
+{
+	bool changed = false;
+	PointIRThread::Reply reply;
+	while( pointIR->takeReply( reply ) )
+	{
+		if( !reply.success )
+		{
+			std::cerr << "PointIR calibration failed" << ( reply.error.empty() ? "" : ": " + reply.error ) << "\n";
+			changed = changed || calibrationTexture;
+			calibrate_stop();
+		}
+		else if( reply.call == PointIRThread::Call::CalibrationImage && calibration == Calibration::RequestingImage )
+		{
+			if( reply.fd >= 0 )
+			{
+				try
+				{
+					calibrationTexture = calibrate_mapImage( reply.fd, reply.width, reply.height );
+					calibration = Calibration::ShowingImage;
+					changed = true;
+				}
+				catch( const std::exception & e )
+				{
+					std::cerr << e.what() << "\n";
+					calibrate_stop();
+				}
+			}
+			else
+			{
+				// DevIL belongs to the image loader
+				calibrationTicket = imageLoader->request( reply.file );
+				calibration = Calibration::LoadingImage;
+			}
+		}
+		else if( reply.fd >= 0 )
+		{
+			close( reply.fd );
+		}
+		else if( reply.call == PointIRThread::Call::Calibrate && calibration == Calibration::Calibrating )
+		{
+			std::cout << "Calibration : done\n";
+			calibrate_stop();
+			changed = true;
+		}
+	}
+
+	if( calibration == Calibration::LoadingImage )
+	{
+		try
+		{
+			std::unique_ptr< Image > image = imageLoader->take( calibrationTicket );
+			if( image )
+			{
+				calibrationTexture = new Texture2D( *image );
+				calibration = Calibration::ShowingImage;
+				changed = true;
+			}
+		}
+		catch( const std::exception & e )
+		{
+			std::cerr << e.what() << "\n";
+			calibrate_stop();
+		}
+	}
+	return changed;
+}
+
+
+// called once the calibration image is on the screen
+void calibrate_shown()
+{
+	if( calibration != Calibration::ShowingImage )
+		return;
+	if( pointIR->requestCalibrate() )
+	{
+		calibration = Calibration::Calibrating;
+	}
+	else
+	{
+		std::cerr << "PointIR is busy - calibration aborted\n";
+		calibrate_stop();
+	}
+}
+
+
+// length 0 sends the whole frame
+void verify_sendFrame( int fd, unsigned int width, unsigned int height, uint8_t value, size_t length = 0 )
+{
+	std::vector< uint8_t > packet( sizeof(PointIR_Frame) + width * height, value );
+	PointIR_Frame * frame = (PointIR_Frame *)packet.data();
+	frame->width = width;
+	frame->height = height;
+	if( send( fd, packet.data(), length ? length : packet.size(), 0 ) < 0 )
+		throw SYSTEM_ERROR( errno, "send" );
+}
+
+
+// a PointIR.Controller stand-in: calibrate succeeds, the image calls fail and saveCalibrationData never answers
+void verify_serveController( DBusConnection * connection, const std::atomic< bool > & quit, std::atomic< unsigned int > & fileCalls )
+{
+	while( !quit && dbus_connection_read_write( connection, 50 ) )
+	{
+		DBusMessage * msg;
+		while( ( msg = dbus_connection_pop_message( connection ) ) )
+		{
+			DBusMessage * reply = nullptr;
+			if( dbus_message_is_method_call( msg, "PointIR.Controller.Processor", "calibrate" ) )
+			{
+				dbus_bool_t result = TRUE;
+				reply = dbus_message_new_method_return( msg );
+				if( reply )
+					dbus_message_append_args( reply, DBUS_TYPE_BOOLEAN, &result, DBUS_TYPE_INVALID );
+			}
+			else if( dbus_message_is_method_call( msg, "PointIR.Controller.Unprojector", "generateCalibrationImageFile" ) )
+			{
+				fileCalls++;
+				reply = dbus_message_new_error( msg, "PointIR.Error.Failed", "no camera" );
+			}
+			else if( dbus_message_get_type( msg ) == DBUS_MESSAGE_TYPE_METHOD_CALL
+			      && !dbus_message_is_method_call( msg, "PointIR.Controller.Unprojector", "saveCalibrationData" ) )
+			{
+				reply = dbus_message_new_error( msg, DBUS_ERROR_UNKNOWN_METHOD, "not implemented" );
+			}
+			if( reply )
+			{
+				dbus_connection_send( connection, reply, nullptr );
+				dbus_message_unref( reply );
+			}
+			dbus_message_unref( msg );
+		}
+	}
+}
+
+
+bool verify_pointIR()
+{
+	unsigned int failures = 0;
+	auto check = [&failures]( const char * what, bool passed )
+	{
+		std::cout << "  " << what << ": " << ( passed ? "ok" : "FAILED" ) << "\n";
+		if( !passed )
+			failures++;
+	};
+
+	std::cout << "PointIR verification\n";
+
+	int sockets[2];
+	if( socketpair( AF_UNIX, SOCK_SEQPACKET, 0, sockets ) )
+		throw SYSTEM_ERROR( errno, "socketpair" );
+	{
+		PointIR::VideoSocketClient video( sockets[0], 64, 48, 4 );
+		check( "Nothing received without frames          ", video.receiveFrame() < 0 );
+
+		for( uint8_t i = 1; i <= 3; i++ )
+			verify_sendFrame( sockets[1], 64, 48, i );
+		int slot = video.receiveFrame();
+		check( "Only the newest frame is returned         ", slot >= 0 && video.getFrame( slot )->data[0] == 3 );
+		check( "Older frames are counted as dropped       ", video.getDroppedFrames() == 2 );
+		check( "Nothing more after the newest frame       ", video.receiveFrame() < 0 );
+		if( slot >= 0 )
+			video.releaseFrame( slot );
+
+		verify_sendFrame( sockets[1], 64, 48, 4, sizeof(PointIR_Frame) / 2 );
+		verify_sendFrame( sockets[1], 64, 48, 4, sizeof(PointIR_Frame) );
+		verify_sendFrame( sockets[1], 64, 48, 4, sizeof(PointIR_Frame) + 64 * 48 - 1 );
+		check( "Short packets are not returned            ", video.receiveFrame() < 0 );
+		check( "Short packets are counted as rejected     ", video.getRejectedFrames() == 3 );
+
+		verify_sendFrame( sockets[1], 256, 192, 5 );
+		check( "A larger frame is rejected once           ", video.receiveFrame() < 0 && video.getRejectedFrames() == 4 );
+		verify_sendFrame( sockets[1], 256, 192, 6 );
+		slot = video.receiveFrame();
+		check( "The next larger frame is received         ", slot >= 0 && video.getFrame( slot )->width == 256 && video.getFrame( slot )->data[256 * 192 - 1] == 6 );
+
+		// every slot lent out - the consumer fell behind
+		std::vector< int > lent;
+		if( slot >= 0 )
+			lent.push_back( slot );
+		while( lent.size() < video.getRingSize() )
+		{
+			verify_sendFrame( sockets[1], 64, 48, 7 );
+			slot = video.receiveFrame();
+			if( slot < 0 )
+				break;
+			lent.push_back( slot );
+		}
+		unsigned int droppedFrames = video.getDroppedFrames();
+		verify_sendFrame( sockets[1], 64, 48, 8 );
+		check( "Frames without a free slot are dropped    ", lent.size() == video.getRingSize() && video.receiveFrame() < 0 && video.getDroppedFrames() == droppedFrames + 1 );
+		for( int s : lent )
+			video.releaseFrame( s );
+		verify_sendFrame( sockets[1], 64, 48, 9 );
+		slot = video.receiveFrame();
+		check( "Released slots are received into again    ", slot >= 0 && video.getFrame( slot )->data[0] == 9 );
+	}
+	close( sockets[1] );
+
+	// the calls go to the stand-in on the session bus, the real daemon lives on the system bus
+	DBusError error;
+	dbus_error_init( &error );
+	DBusConnection * controller = dbus_bus_get_private( DBUS_BUS_SESSION, &error );
+	if( controller && dbus_bus_request_name( controller, "PointIR.Controller", DBUS_NAME_FLAG_DO_NOT_QUEUE, &error ) != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER )
+	{
+		dbus_connection_close( controller );
+		dbus_connection_unref( controller );
+		controller = nullptr;
+	}
+	if( !controller )
+	{
+		std::cout << "  DBus calls skipped - no session bus, or PointIR.Controller is taken" << ( dbus_error_is_set( &error ) ? std::string( " (" ) + error.message + ")" : std::string() ) << "\n";
+		dbus_error_free( &error );
+	}
+	else
+	{
+		std::atomic< bool > quit{ false };
+		std::atomic< unsigned int > fileCalls{ 0 };
+		std::thread server( verify_serveController, controller, std::cref( quit ), std::ref( fileCalls ) );
+		{
+			const int callTimeout = 200;
+			PointIRThread thread( [](){}, "", 0, 0, DBUS_BUS_SESSION, callTimeout );
+			auto begin = std::chrono::steady_clock::now();
+			thread.requestCalibrate();
+			thread.requestCalibrationImage( 64, 48 );
+			thread.requestSaveCalibrationData();
+
+			std::map< PointIRThread::Call, PointIRThread::Reply > replies;
+			std::map< PointIRThread::Call, double > seconds;
+			while( replies.size() < 3 && std::chrono::steady_clock::now() - begin < std::chrono::seconds( 5 ) )
+			{
+				PointIRThread::Reply reply;
+				while( thread.takeReply( reply ) )
+				{
+					seconds[reply.call] = std::chrono::duration< double >( std::chrono::steady_clock::now() - begin ).count();
+					if( reply.fd >= 0 )
+						close( reply.fd );
+					replies[reply.call] = reply;
+				}
+				std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+			}
+
+			const PointIRThread::Reply & calibrate = replies[PointIRThread::Call::Calibrate];
+			const PointIRThread::Reply & image = replies[PointIRThread::Call::CalibrationImage];
+			const PointIRThread::Reply & save = replies[PointIRThread::Call::SaveCalibrationData];
+			double saveSeconds = seconds[PointIRThread::Call::SaveCalibrationData];
+			check( "A call that succeeds replies success      ", calibrate.success && calibrate.error.empty() );
+			check( "A failing call replies the DBus error     ", !image.success && image.error.compare( 0, 20, "PointIR.Error.Failed" ) == 0 );
+			check( "An unknown image call falls back to a file", fileCalls == 1 );
+			check( "An unanswered call times out              ", !save.success && save.error.compare( 0, std::strlen( DBUS_ERROR_NO_REPLY ), DBUS_ERROR_NO_REPLY ) == 0 );
+			check( "It times out after the given timeout      ", saveSeconds >= callTimeout / 1000.0 && saveSeconds < 10 * callTimeout / 1000.0 );
+		}
+		quit = true;
+		server.join();
+		dbus_connection_close( controller );
+		dbus_connection_unref( controller );
+	}
+
+	std::cout << "  " << ( failures ? "FAILED" : "PASSED" ) << "\n";
+	return !failures;
+}
+#endif
+
+
+struct arguments
+{
+	std::string backgroundImageFile;
+	std::string fishTexture;
+	unsigned int waterResolutionDivider = 4;
+	unsigned int numberOfFish = 0;
+	bool headless = false;
+	unsigned int frames = 0;
+	bool cpuWaterSimulator = false;
+	WaterSimulator::Kernel waterSimulatorKernel = WaterSimulator::Kernel::Auto;
+	unsigned int verifyWaterSimulator = 0;
+	unsigned int benchmarkWaterSimulatorWidth = 0;
+	unsigned int benchmarkWaterSimulatorHeight = 0;
+	unsigned int threads = 0;
+	double simulationRate = 60.0;
+	unsigned int maxSubsteps = 4;
+	unsigned int benchmarkTouchGrid = 0;
+	bool batchedFish = false;
+	uint64_t seed = 1;
+	std::string shaderCache; // empty disables the program binary cache
+	WaterEncoding waterEncoding = WaterEncoding::Auto;
+	double idleRate = 0.0; // frames per second while nothing moves, 0 renders only on input
+	std::string assetPack; // pre-decoded images are taken from here instead of being decoded
+	bool cameraView = false; // shows the PointIR camera in a corner
+	bool cameraWater = false; // IR blobs disturb the water like touches
+	bool verifyPointIR = false;
+	unsigned int cameraWidth = 640; // the frame buffers grow if the camera turns out larger
+	unsigned int cameraHeight = 480;
+};
+
+
+void print_usage( int argc, char ** argv )
+{
+	printf
+	(
+		"Usage: %s [--waterResolutionDivider=int] [--numberOfFish=int] [--fishTexture=string] [--headless] [--frames=int] [--waterSimulator=gpu|cpu|cpu-scalar|cpu-sse2|cpu-avx2|cpu-neon] [--verifyWaterSimulator=steps] [--threads=int] [--simulationRate=Hz] [--maxSubsteps=int] [--batchedFish] [--seed=int] [--shaderCache=directory|none] [--waterEncoding=auto|unorm8|half|packed16] [--idleRate=Hz] [--assetPack=file] [--camera=show|water|both] [--cameraSize=<width>x<height>] <background image file>\n"
+		"       %s [--waterSimulator=...] [--threads=int] [--frames=int] --benchmarkWaterSimulator=<width>x<height>\n"
+		"       %s [--frames=int] --benchmarkTouchGrid=<number of touches>\n"
+		"       %s --verifyPointIR\n",
+		argv[0],
+		argv[0],
+		argv[0],
+		argv[0]
+	);
+}
+
+
+int main( int argc, char ** argv )
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	////////////////////////////////
+	// argument parsing
+	struct arguments arguments;
+
+	static struct option long_options[] =
+	{
+		{ "waterResolutionDivider", required_argument, 0, 'd' },
+		{ "numberOfFish",           required_argument, 0, 'f' },
+		{ "fishTexture",            required_argument, 0, 't' },
+		{ "headless",               no_argument,       0, 'H' },
+		{ "frames",                 required_argument, 0, 'n' },
+		{ "waterSimulator",         required_argument, 0, 's' },
+		{ "verifyWaterSimulator",   required_argument, 0, 'V' },
+		{ "benchmarkWaterSimulator",required_argument, 0, 'B' },
+		{ "threads",                required_argument, 0, 'j' },
+		{ "simulationRate",         required_argument, 0, 'r' },
+		{ "maxSubsteps",            required_argument, 0, 'k' },
+		{ "benchmarkTouchGrid",     required_argument, 0, 'G' },
+		{ "batchedFish",            no_argument,       0, 'b' },
+		{ "seed",                   required_argument, 0, 'S' },
+		{ "shaderCache",            required_argument, 0, 'c' },
+		{ "waterEncoding",          required_argument, 0, 'e' },
+		{ "idleRate",               required_argument, 0, 'i' },
+		{ "assetPack",              required_argument, 0, 'a' },
+		{ "camera",                 required_argument, 0, 'C' },
+		{ "cameraSize",             required_argument, 0, 'z' },
+		{ "verifyPointIR",          no_argument,       0, 'P' },
+		{ 0,           0,                              0, 0   }
+	};
+
+	int opt = 0;
+	int option_index = 0;
+	bool shaderCacheSet = false;
+	while( ( opt = getopt_long( argc, argv, "d:f:t:Hn:s:V:B:j:r:k:G:bS:c:e:i:a:C:z:P", long_options, &option_index ) ) != -1 )
+	{
+		switch( opt )
+		{
+		case 'd':
+			arguments.waterResolutionDivider = strtoul( optarg, NULL, 10 );
+			break;
+		case 'f':
+			arguments.numberOfFish = strtoul( optarg, NULL, 10 );
+			break;
+		case 't':
+			arguments.fishTexture = optarg;
+			break;
+		case 'H':
+			arguments.headless = true;
+			break;
+		case 'n':
+			arguments.frames = strtoul( optarg, NULL, 10 );
+			break;
+		case 's':
+			{
+				std::string simulator( optarg );
+				if( simulator == "gpu" )
+				{
+					arguments.cpuWaterSimulator = false;
+				}
+				else if( simulator == "cpu" )
+				{
+					arguments.cpuWaterSimulator = true;
+					arguments.waterSimulatorKernel = WaterSimulator::Kernel::Auto;
+				}
+				else if( simulator.compare( 0, 4, "cpu-" ) == 0 )
+				{
+					try
+					{
+						arguments.waterSimulatorKernel = WaterSimulator::getKernel( simulator.substr( 4 ) );
+					}
+					catch( const std::runtime_error & )
+					{
+						fprintf( stderr, "Unknown water simulator \"%s\"!\n", optarg );
+						print_usage( argc, argv );
+						return EXIT_FAILURE;
+					}
+					if( !WaterSimulator::isSupported( arguments.waterSimulatorKernel ) )
+					{
+						fprintf( stderr, "Water simulator \"%s\" is not supported on this CPU!\n", optarg );
+						return EXIT_FAILURE;
+					}
+					arguments.cpuWaterSimulator = true;
+				}
+				else
+				{
+					fprintf( stderr, "Unknown water simulator \"%s\"!\n", optarg );
+					print_usage( argc, argv );
+					return EXIT_FAILURE;
+				}
+			}
+			break;
+		case 'V':
+			arguments.verifyWaterSimulator = strtoul( optarg, NULL, 10 );
+			break;
+		case 'B':
+			if( sscanf( optarg, "%ux%u", &arguments.benchmarkWaterSimulatorWidth, &arguments.benchmarkWaterSimulatorHeight ) != 2 )
+			{
+				fprintf( stderr, "Expected <width>x<height> for --benchmarkWaterSimulator!\n" );
+				print_usage( argc, argv );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'j':
+			arguments.threads = strtoul( optarg, NULL, 10 );
+			break;
+		case 'r':
+			arguments.simulationRate = strtod( optarg, NULL );
+			if( arguments.simulationRate <= 0.0 )
+			{
+				fprintf( stderr, "Simulation rate must be positive!\n" );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'k':
+			arguments.maxSubsteps = strtoul( optarg, NULL, 10 );
+			break;
+		case 'i':
+			arguments.idleRate = strtod( optarg, NULL );
+			if( arguments.idleRate < 0.0 )
+			{
+				fprintf( stderr, "Idle rate must not be negative!\n" );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'G':
+			arguments.benchmarkTouchGrid = strtoul( optarg, NULL, 10 );
+			break;
+		case 'b':
+			arguments.batchedFish = true;
+			break;
+		case 'S':
+			arguments.seed = strtoull( optarg, NULL, 10 );
+			break;
+		case 'c':
+			arguments.shaderCache = optarg;
+			shaderCacheSet = true;
+			break;
+		case 'e':
+			{
+				std::string encoding( optarg );
+				if( encoding == "auto" )
+					arguments.waterEncoding = WaterEncoding::Auto;
+				else if( encoding == "unorm8" )
+					arguments.waterEncoding = WaterEncoding::Unorm8;
+				else if( encoding == "half" )
+					arguments.waterEncoding = WaterEncoding::HalfFloat;
+				else if( encoding == "packed16" )
+					arguments.waterEncoding = WaterEncoding::Packed16;
+				else
+				{
+					fprintf( stderr, "Unknown water encoding \"%s\"!\n", optarg );
+					print_usage( argc, argv );
+					return EXIT_FAILURE;
+				}
+			}
+			break;
+		case 'a':
+			arguments.assetPack = optarg;
+			break;
+		case 'C':
+			{
+				std::string camera( optarg );
+				arguments.cameraView = camera == "show" || camera == "both";
+				arguments.cameraWater = camera == "water" || camera == "both";
+				if( !arguments.cameraView && !arguments.cameraWater )
+				{
+					fprintf( stderr, "Unknown camera mode \"%s\"!\n", optarg );
+					print_usage( argc, argv );
+					return EXIT_FAILURE;
+				}
+			}
+			break;
+		case 'z':
+			if( sscanf( optarg, "%ux%u", &arguments.cameraWidth, &arguments.cameraHeight ) != 2 || !arguments.cameraWidth || !arguments.cameraHeight )
+			{
+				fprintf( stderr, "Expected <width>x<height> for --cameraSize!\n" );
+				print_usage( argc, argv );
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'P':
+			arguments.verifyPointIR = true;
+			break;
+		default:
+			print_usage( argc, argv );
+			return EXIT_FAILURE;
+		}
+	}
+
+	rng = Random( arguments.seed );
+
+	if( !shaderCacheSet )
+	{
+		if( getenv( "XDG_CACHE_HOME" ) && *getenv( "XDG_CACHE_HOME" ) )
+			arguments.shaderCache = std::string( getenv( "XDG_CACHE_HOME" ) ) + "/glesPond";
+		else if( getenv( "HOME" ) )
+			arguments.shaderCache = std::string( getenv( "HOME" ) ) + "/.cache/glesPond";
+	}
+	else if( arguments.shaderCache == "none" )
+	{
+		arguments.shaderCache.clear();
+	}
+
+	if( arguments.benchmarkWaterSimulatorWidth && arguments.benchmarkWaterSimulatorHeight )
+	{
+		unsigned int maxThreads = arguments.threads ? arguments.threads : std::max( 1u, std::thread::hardware_concurrency() );
+		benchmark_waterSimulator( arguments.waterSimulatorKernel, arguments.benchmarkWaterSimulatorWidth, arguments.benchmarkWaterSimulatorHeight, arguments.frames ? arguments.frames : 100, maxThreads );
+		return EXIT_SUCCESS;
+	}
+
+	if( arguments.benchmarkTouchGrid )
+	{
+		benchmark_touchGrid( arguments.benchmarkTouchGrid, arguments.frames ? arguments.frames : 100 );
+		return EXIT_SUCCESS;
+	}
+
+	if( arguments.verifyPointIR )
+	{
+#ifdef GLESPOND_POINTIR
+		return verify_pointIR() ? EXIT_SUCCESS : EXIT_FAILURE;
+#else
+		fprintf( stderr, "Built without PointIR support!\n" );
+		return EXIT_FAILURE;
+#endif
+	}
+
+	if( optind+1 != argc )
 	{
 		fprintf( stderr, "Need a background image file!\n" );
 		print_usage( argc, argv );
@@ -610,7 +1724,87 @@ int main( int argc, char ** argv )
 	ilOriginFunc( IL_ORIGIN_LOWER_LEFT );
 
 	//SDL_LogSetAllPriority( SDL_LOG_PRIORITY_DEBUG );
-	SDL_Init( SDL_INIT_VIDEO | SDL_INIT_EVENTS );
+	if( arguments.headless )
+	{
+		// prefer SDL's offscreen video driver (EGL pbuffer) so no display server is needed
+		setenv( "SDL_VIDEODRIVER", "offscreen", 0 );
+		if( SDL_Init( SDL_INIT_VIDEO | SDL_INIT_EVENTS ) )
+		{
+			std::cerr << "Could not initialise offscreen video driver (" << SDL_GetError() << ") - falling back to default\n";
+			unsetenv( "SDL_VIDEODRIVER" );
+			if( SDL_Init( SDL_INIT_VIDEO | SDL_INIT_EVENTS ) )
+				throw SDL2_ERROR( "Could not initialise SDL" );
+		}
+	}
+	else
+	{
+		SDL_Init( SDL_INIT_VIDEO | SDL_INIT_EVENTS );
+	}
+
+#ifdef GLESPOND_POINTIR
+	pointIREvent = SDL_RegisterEvents( 1 );
+	try
+	{
+		pointIR = new PointIRThread( []()
+		{
+			SDL_Event event;
+			SDL_zero( event );
+			event.type = pointIREvent;
+			SDL_PushEvent( &event );
+		}, "/tmp/PointIR.video.socket", arguments.cameraWidth, arguments.cameraHeight );
+	}
+	catch( const std::exception & e )
+	{
+		std::cerr << "PointIR     : not available (" << e.what() << ")\n";
+	}
+	if( ( arguments.cameraView || arguments.cameraWater ) && !( pointIR && pointIR->hasVideo() ) )
+	{
+		std::cerr << "Camera      : no PointIR video\n";
+		arguments.cameraView = arguments.cameraWater = false;
+	}
+	if( arguments.cameraWater && arguments.cpuWaterSimulator )
+	{
+		std::cerr << "Camera      : only the GPU water simulator is driven by the camera\n";
+		arguments.cameraWater = false;
+	}
+	if( arguments.cameraView || arguments.cameraWater )
+		pointIR->setNotifyFrames( true );
+#else
+	if( arguments.cameraView || arguments.cameraWater )
+	{
+		std::cerr << "Camera      : needs PointIR support\n";
+		arguments.cameraView = arguments.cameraWater = false;
+	}
+#endif
+
+	// the images decode while the window, the context and the shaders are set up - the background is stretched
+	// over the window, so anything larger than the display is wasted (headless the screen has the size of the image)
+	unsigned int backgroundMaxWidth = 0;
+	unsigned int backgroundMaxHeight = 0;
+	SDL_DisplayMode desktopMode;
+	if( !arguments.headless && SDL_GetDesktopDisplayMode( 0, &desktopMode ) == 0 )
+	{
+		backgroundMaxWidth = desktopMode.w;
+		backgroundMaxHeight = desktopMode.h;
+	}
+	imageLoader = new ImageLoader();
+	// images in the pack are mapped instead of decoded - the pixels are read in while the context is set up
+	std::unique_ptr< Image > backgroundImage;
+	std::unique_ptr< Image > fishImage;
+	if( !arguments.assetPack.empty() )
+	{
+		assetPack = new AssetPack( arguments.assetPack );
+		std::cout << "Assets      : " << assetPack->getImageCount() << " images in " << assetPack->getFile() << "\n";
+		backgroundImage = assetPack->getImage( arguments.backgroundImageFile );
+		if( arguments.numberOfFish )
+			fishImage = assetPack->getImage( arguments.fishTexture );
+	}
+	unsigned int backgroundTicket = 0;
+	if( !backgroundImage )
+		backgroundTicket = imageLoader->request( arguments.backgroundImageFile, backgroundMaxWidth, backgroundMaxHeight );
+	unsigned int fishTicket = 0;
+	if( arguments.numberOfFish && !fishImage )
+		fishTicket = imageLoader->request( arguments.fishTexture );
 
 	SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES );
 	SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 2 );
@@ -628,7 +1822,7 @@ int main( int argc, char ** argv )
 		SDL_WINDOWPOS_CENTERED, // the x position of the window
 		SDL_WINDOWPOS_CENTERED, // the y position of the window
 		640, 640, // window width and height
-		SDL_WINDOW_MAXIMIZED | SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL
+		arguments.headless ? ( SDL_WINDOW_HIDDEN | SDL_WINDOW_OPENGL ) : ( SDL_WINDOW_MAXIMIZED | SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL )
 	);
 	if( !window )
 		throw SDL2_ERROR( "Could not create window" );
@@ -642,7 +1836,8 @@ int main( int argc, char ** argv )
 		throw SDL2_ERROR( "Could not create OpenGL context" );
 
 	SDL_GL_MakeCurrent( window, glContext );
-	SDL_GL_SetSwapInterval( 1 );
+	GLState::invalidate();
+	SDL_GL_SetSwapInterval( arguments.headless ? 0 : 1 );
 
 	glClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
 	glClearDepthf( 1.0f );
@@ -671,95 +1866,334 @@ int main( int argc, char ** argv )
 	////////////////////////////////
 	// VBOs
 	glGenBuffers( 1, &vertexBufferCenteredQuadPT);
-	glBindBuffer( GL_ARRAY_BUFFER, vertexBufferCenteredQuadPT );
+	GLState::bindBuffer( vertexBufferCenteredQuadPT );
 	glBufferData( GL_ARRAY_BUFFER, sizeof(centeredQuadPT), centeredQuadPT, GL_STATIC_DRAW );
 
-	glGenBuffers( 1, &vertexBufferCenteredCirclePC);
-	glBindBuffer( GL_ARRAY_BUFFER, vertexBufferCenteredCirclePC );
-	glBufferData( GL_ARRAY_BUFFER, sizeof(centeredCirclePC), centeredCirclePC, GL_STATIC_DRAW );
+	glGenBuffers( 2, vertexBuffersModulator );
+	glGenBuffers( 1, &indexBufferModulator );
+
+	glGenBuffers( 1, &vertexBufferFish );
+	////////////////////////////////
+
+	////////////////////////////////
+	// Water encoding
+	waterEncoding = arguments.waterEncoding;
+	if( arguments.cpuWaterSimulator || arguments.verifyWaterSimulator )
+	{
+		if( waterEncoding != WaterEncoding::Auto && waterEncoding != WaterEncoding::Unorm8 )
+			std::cerr << "The CPU water simulator only supports the unorm8 water encoding\n";
+		waterEncoding = WaterEncoding::Unorm8;
+	}
+	if( waterEncoding == WaterEncoding::Auto || waterEncoding == WaterEncoding::HalfFloat )
+	{
+		// the drawer magnifies the water with linear filtering
+		bool halfFloat = SDL_GL_ExtensionSupported( "GL_OES_texture_half_float" ) && SDL_GL_ExtensionSupported( "GL_OES_texture_half_float_linear" );
+		if( halfFloat )
+		{
+			// rendering to half floats is an extension of its own, which not every driver that can do it announces
+			try
+			{
+				FrameBuffer2D probe( 4, 4, GL_RGBA, GL_HALF_FLOAT_OES );
+			}
+			catch( const std::exception & )
+			{
+				GLES2_ERROR_CLEAR();
+				halfFloat = false;
+			}
+		}
+		if( !halfFloat && waterEncoding == WaterEncoding::HalfFloat )
+			std::cerr << "Half float render targets are not supported - falling back to packed16\n";
+		waterEncoding = halfFloat ? WaterEncoding::HalfFloat : WaterEncoding::Packed16;
+	}
+	switch( waterEncoding )
+	{
+	case WaterEncoding::HalfFloat:
+		waterEncodingSRC = waterEncodingSRC_halfFloat;
+		std::cout << "Water state : half float\n";
+		break;
+	case WaterEncoding::Packed16:
+		waterEncodingSRC = waterEncodingSRC_packed16;
+		std::cout << "Water state : packed 16 bit\n";
+		break;
+	default:
+		waterEncodingSRC = waterEncodingSRC_unorm8;
+		std::cout << "Water state : unorm8\n";
+		break;
+	}
 	////////////////////////////////
 
 	////////////////////////////////
 	// Shaders
-	program_waterDrawer.create();
-	program_waterDrawer.attach( Shader( GL_VERTEX_SHADER, vertexShaderSRC_waterDrawer ) );
-	program_waterDrawer.attach( Shader( GL_FRAGMENT_SHADER, fragmentShaderSRC_waterDrawer ) );
-	program_waterDrawer.link();
+	ProgramCache * programCache = nullptr;
+	if( !arguments.shaderCache.empty() && SDL_GL_ExtensionSupported( "GL_OES_get_program_binary" ) )
+	{
+		try
+		{
+			programCache = new ProgramCache( arguments.shaderCache,
+				(PFNGLGETPROGRAMBINARYOESPROC)SDL_GL_GetProcAddress( "glGetProgramBinaryOES" ),
+				(PFNGLPROGRAMBINARYOESPROC)SDL_GL_GetProcAddress( "glProgramBinaryOES" ) );
+		}
+		catch( const std::exception & e )
+		{
+			std::cerr << "Shader cache disabled: " << e.what() << "\n";
+		}
+	}
+
+	program_waterDrawer.build( vertexShaderSRC_waterDrawer, fragmentShaderSRC_waterDrawer, programCache );
 	program_waterDrawer_aPosition = program_waterDrawer.getAttributeLocation( "aPosition" );
 	program_waterDrawer_aTexCoord = program_waterDrawer.getAttributeLocation( "aTexCoord" );
-	program_waterDrawer_uWaterTexture = program_waterDrawer.getUniformLocation( "uWaterTexture" );
+	program_waterDrawer_uNormalTexture = program_waterDrawer.getUniformLocation( "uNormalTexture" );
 	program_waterDrawer_uBackgroundTexture = program_waterDrawer.getUniformLocation( "uBackgroundTexture" );
 
-	program_water.create();
-	program_water.attach( Shader( GL_VERTEX_SHADER, vertexShaderSRC_water ) );
-	program_water.attach( Shader( GL_FRAGMENT_SHADER, fragmentShaderSRC_water ) );
-	program_water.link();
+	program_waterNormal.build( vertexShaderSRC_waterDrawer, water_shaderSource( fragmentShaderSRC_waterNormal ), programCache );
+	program_waterNormal_aPosition = program_waterNormal.getAttributeLocation( "aPosition" );
+	program_waterNormal_aTexCoord = program_waterNormal.getAttributeLocation( "aTexCoord" );
+	program_waterNormal_uWaterTexture = program_waterNormal.getUniformLocation( "uWaterTexture" );
+	program_waterNormal_uWaterDeltaPixel = program_waterNormal.getUniformLocation( "uWaterDeltaPixel" );
+
+	program_water.build( vertexShaderSRC_water, water_shaderSource( fragmentShaderSRC_water ), programCache );
 	program_water_aPosition = program_water.getAttributeLocation( "aPosition" );
 	program_water_aTexCoord = program_water.getAttributeLocation( "aTexCoord" );
 	program_water_uTexture = program_water.getUniformLocation( "uTexture" );
 	program_water_uDeltaPixel = program_water.getUniformLocation( "uDeltaPixel" );
 
-	program_waterModulator.create();
-	program_waterModulator.attach( Shader( GL_VERTEX_SHADER, vertexShaderSRC_waterModulator ) );
-	program_waterModulator.attach( Shader( GL_FRAGMENT_SHADER, fragmentShaderSRC_waterModulator ) );
-	program_waterModulator.link();
+	program_waterModulator.build( vertexShaderSRC_waterModulator, water_shaderSource( fragmentShaderSRC_waterModulator ), programCache );
 	program_waterModulator_aPosition = program_waterModulator.getAttributeLocation( "aPosition" );
 	program_waterModulator_aColor = program_waterModulator.getAttributeLocation( "aColor" );
-	program_waterModulator_uPosition = program_waterModulator.getUniformLocation( "uPosition" );
-	program_waterModulator_uScale = program_waterModulator.getUniformLocation( "uScale" );
 
-	program_copy.create();
-	program_copy.attach( Shader( GL_VERTEX_SHADER, vertexShaderSRC_copy ) );
-	program_copy.attach( Shader( GL_FRAGMENT_SHADER, fragmentShaderSRC_copy ) );
-	program_copy.link();
+	program_copy.build( vertexShaderSRC_copy, fragmentShaderSRC_copy, programCache );
 	program_copy_aPosition = program_copy.getAttributeLocation( "aPosition" );
 	program_copy_aTexCoord = program_copy.getAttributeLocation( "aTexCoord" );
 	program_copy_uTexture = program_copy.getUniformLocation( "uTexture" );
 
-	program_fish.create();
-	program_fish.attach( Shader( GL_VERTEX_SHADER, vertexShaderSRC_fish ) );
-	program_fish.attach( Shader( GL_FRAGMENT_SHADER, fragmentShaderSRC_fish ) );
-	program_fish.link();
-	program_fish_aPosition = program_fish.getAttributeLocation( "aPosition" );
-	program_fish_aTexCoord = program_fish.getAttributeLocation( "aTexCoord" );
-	program_fish_uTexture = program_fish.getUniformLocation( "uTexture" );
-	program_fish_uMatrix = program_fish.getUniformLocation( "uMatrix" );
-	program_fish_uPhaseFreqAmp = program_fish.getUniformLocation( "uPhaseFreqAmp" );
+	if( arguments.cameraView )
+	{
+		program_camera.build( vertexShaderSRC_camera, fragmentShaderSRC_camera, programCache );
+		program_camera_aPosition = program_camera.getAttributeLocation( "aPosition" );
+		program_camera_aTexCoord = program_camera.getAttributeLocation( "aTexCoord" );
+		program_camera_uTexture = program_camera.getUniformLocation( "uTexture" );
+	}
+	if( arguments.cameraWater )
+	{
+		program_waterCameraModulator.build( vertexShaderSRC_camera, water_shaderSource( fragmentShaderSRC_waterCameraModulator ), programCache );
+		program_waterCameraModulator_aPosition = program_waterCameraModulator.getAttributeLocation( "aPosition" );
+		program_waterCameraModulator_aTexCoord = program_waterCameraModulator.getAttributeLocation( "aTexCoord" );
+		program_waterCameraModulator_uTexture = program_waterCameraModulator.getUniformLocation( "uTexture" );
+		program_waterCameraModulator_uThreshold = program_waterCameraModulator.getUniformLocation( "uThreshold" );
+	}
+
+	if( !arguments.batchedFish )
+	{
+		if( SDL_GL_ExtensionSupported( "GL_EXT_instanced_arrays" ) )
+		{
+			drawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDEXTPROC)SDL_GL_GetProcAddress( "glDrawArraysInstancedEXT" );
+			vertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISOREXTPROC)SDL_GL_GetProcAddress( "glVertexAttribDivisorEXT" );
+		}
+		else if( SDL_GL_ExtensionSupported( "GL_ANGLE_instanced_arrays" ) )
+		{
+			drawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDEXTPROC)SDL_GL_GetProcAddress( "glDrawArraysInstancedANGLE" );
+			vertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISOREXTPROC)SDL_GL_GetProcAddress( "glVertexAttribDivisorANGLE" );
+		}
+		if( !drawArraysInstanced || !vertexAttribDivisor )
+			drawArraysInstanced = nullptr;
+		else
+			GLState::setVertexAttribDivisorFunction( vertexAttribDivisor );
+	}
+	std::cout << "Fish        : " << ( drawArraysInstanced ? "instanced" : "batched" ) << "\n";
+
+	if( drawArraysInstanced )
+	{
+		program_fishInstanced.build( vertexShaderSRC_fishInstanced, fragmentShaderSRC_fish, programCache );
+		program_fishInstanced_aPosition = program_fishInstanced.getAttributeLocation( "aPosition" );
+		program_fishInstanced_aTexCoord = program_fishInstanced.getAttributeLocation( "aTexCoord" );
+		program_fishInstanced_aInstance = program_fishInstanced.getAttributeLocation( "aInstance" );
+		program_fishInstanced_aPhase = program_fishInstanced.getAttributeLocation( "aPhase" );
+		program_fishInstanced_uTexture = program_fishInstanced.getUniformLocation( "uTexture" );
+		program_fishInstanced_uFreqAmp = program_fishInstanced.getUniformLocation( "uFreqAmp" );
+	}
+	else
+	{
+		program_fishBatched.build( vertexShaderSRC_fishBatched, fragmentShaderSRC_fish, programCache );
+		program_fishBatched_aPosition = program_fishBatched.getAttributeLocation( "aPosition" );
+		program_fishBatched_aTexCoord = program_fishBatched.getAttributeLocation( "aTexCoord" );
+		program_fishBatched_aPhase = program_fishBatched.getAttributeLocation( "aPhase" );
+		program_fishBatched_uTexture = program_fishBatched.getUniformLocation( "uTexture" );
+		program_fishBatched_uFreqAmp = program_fishBatched.getUniformLocation( "uFreqAmp" );
+	}
+
+	if( programCache )
+	{
+		std::cout << "Shader cache: " << programCache->getLoaded() << " loaded, " << programCache->getRejected() << " rejected, " << programCache->getSaved() << " saved (" << programCache->getDirectory() << ")\n";
+		delete programCache;
+	}
 	////////////////////////////////
 
 	////////////////////////////////
 	// Textures and FrameBuffers
+	auto waitBegin = std::chrono::steady_clock::now();
+	// whatever the loader finished while the context and the shaders were set up costs no time here
+	unsigned int imagesPending = imageLoader->getPendingCount();
 	if( arguments.numberOfFish )
-		fishTexture = new Texture2D( arguments.fishTexture );
-	backgroundTexture = new Texture2D( arguments.backgroundImageFile );
-	backgroundFrameBuffer = new FrameBuffer2D( backgroundTexture->getWidth(), backgroundTexture->getHeight(), GL_RGBA );
-	waterFrameBufferDst = new FrameBuffer2D( backgroundTexture->getWidth()/arguments.waterResolutionDivider, backgroundTexture->getHeight()/arguments.waterResolutionDivider, GL_RGBA );
-	waterFrameBufferSrc = new FrameBuffer2D( backgroundTexture->getWidth()/arguments.waterResolutionDivider, backgroundTexture->getHeight()/arguments.waterResolutionDivider, GL_RGBA );
+	{
+		if( !fishImage )
+			fishImage = imageLoader->wait( fishTicket );
+		fishTexture = new Texture2D( *fishImage, image_minFilter( *fishImage ), GL_LINEAR, GL_REPEAT, GL_REPEAT );
+		fishImage.reset();
+	}
+	{
+		if( !backgroundImage )
+			backgroundImage = imageLoader->wait( backgroundTicket );
+		else if( !backgroundImage->isCompressed() )
+			backgroundImage->downscale( backgroundMaxWidth, backgroundMaxHeight ); // copies only if the pack was made for a larger display
+		// clamped like the framebuffer texture, because the drawer samples it directly when there are no fish
+		backgroundTexture = new Texture2D( *backgroundImage, image_minFilter( *backgroundImage ), GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE );
+		backgroundImage.reset();
+	}
+	std::cout << "Images      : " << imagesPending << " still decoding, waited " << std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - waitBegin ).count() << "ms for decoding\n";
+	std::cout << "Background  : " << backgroundTexture->getWidth() << "x" << backgroundTexture->getHeight() << "\n";
+	unsigned int waterWidth = backgroundTexture->getWidth()/arguments.waterResolutionDivider;
+	unsigned int waterHeight = backgroundTexture->getHeight()/arguments.waterResolutionDivider;
+	threadPool = new ThreadPool( arguments.threads );
+	if( arguments.cpuWaterSimulator )
+	{
+		waterSimulator = new WaterSimulator( waterWidth, waterHeight, arguments.waterSimulatorKernel, threadPool );
+		waterTexture = new Texture2D( waterWidth, waterHeight, GL_RGBA, GL_NEAREST, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE );
+		std::cout << "Water       : CPU (" << WaterSimulator::getName( waterSimulator->getKernel() ) << ", " << threadPool->getThreadCount() << " threads) " << waterWidth << "x" << waterHeight << "\n";
+	}
+	else
+	{
+		GLenum type = waterEncoding == WaterEncoding::HalfFloat ? GL_HALF_FLOAT_OES : GL_UNSIGNED_BYTE;
+		waterFrameBufferDst = new FrameBuffer2D( waterWidth, waterHeight, GL_RGBA, type );
+		waterFrameBufferSrc = new FrameBuffer2D( waterWidth, waterHeight, GL_RGBA, type );
+		water_clear( waterFrameBufferDst );
+		water_clear( waterFrameBufferSrc );
+		std::cout << "Water       : GPU " << waterWidth << "x" << waterHeight << "\n";
+	}
+	// flat until the first step
+	waterNormalFrameBuffer = new FrameBuffer2D( waterWidth, waterHeight, GL_RGBA );
+	waterNormalFrameBuffer->clear( 0.5f, 0.5f, 0.5f, 0.5f );
+	waterDirtyRegion = new DirtyRegion( waterWidth, waterHeight, water_settleSteps() );
+	std::cout << "Water       : settles " << waterDirtyRegion->getSettleSteps() << " steps after the last touch\n";
+#ifdef GLESPOND_POINTIR
+	if( arguments.cameraView || arguments.cameraWater )
+		cameraTexture = new StreamingTexture( GL_LUMINANCE );
+#endif
+	if( arguments.headless )
+		screenFrameBuffer = new FrameBuffer2D( backgroundTexture->getWidth(), backgroundTexture->getHeight(), GL_RGBA );
 	////////////////////////////////
 
+	if( arguments.verifyWaterSimulator )
+	{
+		bool passed = verify_waterSimulator( arguments.waterSimulatorKernel, waterWidth, waterHeight, arguments.verifyWaterSimulator );
+		SDL_Quit();
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	////////////////////////////////
 	// Initialize fish
+	// each fish draws from its own stream, so it looks the same no matter how many fish there are
 	for( unsigned int i = 0; i < arguments.numberOfFish; i++ )
 	{
+		Random random( arguments.seed, i );
 		Fish f;
-		f.position[0] = randf() * 2.0f - 1.0f;
-		f.position[1] = randf() * 2.0f - 1.0f;
-		f.rotation = randf() * 2.0f * PI;
-		f.scale = randf() * 0.02f + 0.08f;
-		f.agility = randf() * 0.005f + 0.001f;
-		f.minSpeed = randf() * 0.001f + 0.0005f;
-		f.maxSpeed = randf() * 0.01f + 0.004f;
-		f.rotationMaxSpeed = randf() * 0.4f + 0.1f;
-		f.sensitivityDistance = randf() * 0.4f + 0.1f;
-		fish.push_back( f );
+		f.position[0] = random.nextFloat() * 2.0f - 1.0f;
+		f.position[1] = random.nextFloat() * 2.0f - 1.0f;
+		f.rotation = random.nextFloat() * 2.0f * PI;
+		f.scale = random.nextFloat() * 0.02f + 0.08f;
+		f.agility = random.nextFloat() * 0.005f + 0.001f;
+		f.minSpeed = random.nextFloat() * 0.001f + 0.0005f;
+		f.maxSpeed = random.nextFloat() * 0.01f + 0.004f;
+		f.rotationMaxSpeed = random.nextFloat() * 0.4f + 0.1f;
+		f.sensitivityDistance = random.nextFloat() * 0.4f + 0.1f;
+		fish.add( f );
 	}
+	std::cout << "Fish update : " << threadPool->getThreadCount() << " threads, seed " << arguments.seed << "\n";
 	////////////////////////////////
 
+	////////////////////////////////
+	// Timing
+	StageTimer timer;
+	const unsigned int stage_events = timer.addStage( "events" );
+	const unsigned int stage_waterModulator = timer.addStage( "render_waterModulator" );
+	const unsigned int stage_water = timer.addStage( "render_water" );
+	const unsigned int stage_waterNormal = timer.addStage( "render_waterNormal" );
+	const unsigned int stage_copy = timer.addStage( "render_copy" );
+	const unsigned int stage_updateFish = timer.addStage( "update_fish" );
+	const unsigned int stage_fish = timer.addStage( "render_fish" );
+	const unsigned int stage_waterDrawer = timer.addStage( "render_waterDrawer" );
+	const unsigned int stage_swap = timer.addStage( "swap" );
+
+	// when running headless each stage waits for the GPU, so its timing includes the GPU work it issued
+	auto lap = [&]( unsigned int stage )
+	{
+		if( arguments.headless )
+			glFinish();
+		timer.lap( stage );
+	};
+	////////////////////////////////
+
+	FixedTimestep timestep( arguments.simulationRate, arguments.maxSubsteps );
+	auto lastFrameTime = std::chrono::steady_clock::now();
+
+	// a background dropped onto the window is decoded while the pond keeps going
+	bool backgroundPending = false;
+	std::string backgroundPendingFile;
+
 	bool quit = false;
+	bool firstFrame = true;
+	bool redraw = true; // set when the last composited frame is stale, e.g. after an expose
+	bool backgroundComposed = false; // backgroundFrameBuffer shows the current fish on the current background
+	int lastW = 0, lastH = 0;
+	unsigned long glCallsBefore = GLState::getCalls();
+	unsigned long glSavedCallsBefore = GLState::getSavedCalls();
+	timer.mark();
 	while( !quit )
 	{
 		int w = 0, h = 0;
-		SDL_GetWindowSize( window, &w, &h );
+		if( screenFrameBuffer )
+		{
+			w = screenFrameBuffer->getWidth();
+			h = screenFrameBuffer->getHeight();
+		}
+		else
+		{
+			SDL_GetWindowSize( window, &w, &h );
+		}
+		if( w != lastW || h != lastH )
+		{
+			// the layer under the water is only ever shown at the size of the viewport
+			if( arguments.numberOfFish )
+			{
+				delete backgroundFrameBuffer;
+				backgroundFrameBuffer = new FrameBuffer2D( w, h, GL_RGBA );
+				backgroundComposed = false;
+			}
+			redraw = true;
+			lastW = w;
+			lastH = h;
+		}
+
+		// nothing moves and nothing is due - block until there is input instead of polling, or until the next idle frame
+		bool idle = touches.empty() && !arguments.numberOfFish && waterDirtyRegion->isEmpty() && !redraw && !backgroundPending;
+#ifdef GLESPOND_POINTIR
+		// the daemon wakes the loop with an event, the image loader does not
+		if( calibration == Calibration::LoadingImage || cameraBlobs )
+			idle = false;
+#endif
+		if( idle && !arguments.headless )
+		{
+			if( arguments.idleRate > 0.0 )
+			{
+				if( !SDL_WaitEventTimeout( nullptr, std::max( 1, (int)( 1000.0 / arguments.idleRate ) ) ) )
+					redraw = true;
+			}
+			else
+			{
+				SDL_WaitEvent( nullptr );
+			}
+			// the time asleep must not turn into a backlog of steps
+			lastFrameTime = std::chrono::steady_clock::now();
+		}
 
 		SDL_Event sdlEvent;
 		while( SDL_PollEvent( &sdlEvent ) )
@@ -769,14 +2203,27 @@ int main( int argc, char ** argv )
 			case SDL_QUIT:
 				quit = true;
 				break;
+			case SDL_WINDOWEVENT:
+				if( sdlEvent.window.event == SDL_WINDOWEVENT_EXPOSED )
+					redraw = true;
+				break;
+			case SDL_DROPFILE:
+				if( backgroundPending )
+					imageLoader->cancel( backgroundTicket );
+				backgroundPendingFile = sdlEvent.drop.file;
+				SDL_free( sdlEvent.drop.file );
+				backgroundTicket = imageLoader->request( backgroundPendingFile, backgroundMaxWidth, backgroundMaxHeight );
+				backgroundPending = true;
+				SDL_SetWindowTitle( window, ( "glesPond - loading " + backgroundPendingFile ).c_str() );
+				break;
 			case SDL_MOUSEBUTTONDOWN:
 				{
 					Touch t;
 					t.point[0] = (sdlEvent.button.x/(float)w)*2.0-1.0f;
 					t.point[1] = -((sdlEvent.button.y/(float)h)*2.0-1.0f);
-					t.r = rand() % 128 + 127;
-					t.g = rand() % 128 + 127;
-					t.b = rand() % 128 + 127;
+					t.r = rng.next() % 128 + 127;
+					t.g = rng.next() % 128 + 127;
+					t.b = rng.next() % 128 + 127;
 					touches[ -1 ] = t;
 				}
 				break;
@@ -799,9 +2246,9 @@ int main( int argc, char ** argv )
 					Touch t;
 					t.point[0] = (sdlEvent.tfinger.x/(float)w)*2.0-1.0f;
 					t.point[1] = -((sdlEvent.tfinger.y/(float)h)*2.0-1.0f);
-					t.r = rand() % 128 + 127;
-					t.g = rand() % 128 + 127;
-					t.b = rand() % 128 + 127;
+					t.r = rng.next() % 128 + 127;
+					t.g = rng.next() % 128 + 127;
+					t.b = rng.next() % 128 + 127;
 					touches[ sdlEvent.tfinger.fingerId ] = t;
 				}
 				break;
@@ -827,7 +2274,8 @@ int main( int argc, char ** argv )
 					break;
 #ifdef GLESPOND_POINTIR
 				case SDLK_SPACE:
-					calibrate();
+					if( pointIR )
+						calibrate();
 					break;
 #endif
 				case SDLK_RETURN:
@@ -852,37 +2300,292 @@ int main( int argc, char ** argv )
 			}
 		}
 
-		waterFrameBufferSrc->bind();
-		for( const auto & t : touches )
+		if( arguments.headless )
 		{
-			render_waterModulator( t.second.point, 0.03f );
+			// there is no input without a window - let a finger circle through the pond instead
+			float angle = timer.getFrames() * 0.02f;
+			Touch & t = touches[ -1 ];
+			t.point[0] = 0.5f * std::cos( angle );
+			t.point[1] = 0.5f * std::sin( angle );
+			t.r = t.g = t.b = 255;
 		}
 
-		waterFrameBufferDst->bind();
-		render_water( waterFrameBufferSrc->getTexture(), waterFrameBufferSrc->getTexture()->getWidth(), waterFrameBufferSrc->getTexture()->getHeight() );
+#ifdef GLESPOND_POINTIR
+		if( pointIR && calibrate_update() )
+			redraw = true;
 
-		backgroundFrameBuffer->bind();
-		render_copy( backgroundTexture );
-		if( arguments.numberOfFish )
+		// only the newest frame is uploaded - the ones the camera delivered in between are skipped
+		const PointIR_Frame * cameraFrame = cameraTexture ? pointIR->takeFrame() : nullptr;
+		if( cameraFrame )
 		{
-			update_fish( fish, touches );
-			render_fish( fish );
+			// straight from the receive buffer - the frame is not copied on the way
+			cameraTexture->upload( cameraFrame->data, cameraFrame->width, cameraFrame->height );
+			if( arguments.cameraView )
+				redraw = true;
+			if( arguments.cameraWater )
+				cameraBlobs = camera_findBlobs( cameraFrame->data, cameraFrame->width, cameraFrame->height, cameraBlobsPosition, cameraBlobsRadius );
+		}
+#endif
+
+		if( backgroundPending )
+		{
+			try
+			{
+				std::unique_ptr< Image > image = imageLoader->take( backgroundTicket );
+				if( image )
+				{
+					// the water keeps its resolution - it is sampled with normalised coordinates anyway
+					delete backgroundTexture;
+					backgroundTexture = new Texture2D( *image, image_minFilter( *image ), GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE );
+					backgroundComposed = false;
+					redraw = true;
+					std::cout << "Background  : " << image->getFile() << " " << image->getWidth() << "x" << image->getHeight() << "\n";
+					backgroundPending = false;
+				}
+			}
+			catch( const std::exception & e )
+			{
+				std::cerr << e.what() << "\n";
+				backgroundPending = false;
+			}
+			if( !backgroundPending )
+				SDL_SetWindowTitle( window, "glesPond" );
 		}
+		lap( stage_events );
 
-		glBindFramebuffer( GL_FRAMEBUFFER, 0 );
-		glViewport( 0, 0, w, h );
-		render_waterDrawer( waterFrameBufferDst->getTexture(), backgroundFrameBuffer->getTexture() );
+		touchGrid.rebuild( touches );
 
-		std::swap( waterFrameBufferSrc, waterFrameBufferDst );
+		// headless runs are benchmarks - they simulate exactly one step per frame to stay reproducible
+		auto frameTime = std::chrono::steady_clock::now();
+		unsigned int substeps = timestep.advance( arguments.headless ? timestep.getStepSeconds() : std::chrono::duration< double >( frameTime - lastFrameTime ).count() );
+		lastFrameTime = frameTime;
 
-		SDL_GL_SwapWindow( window );
+		// calm water is neither simulated nor composited again
+		bool waterChanged = false;
+		if( waterSimulator )
+		{
+			for( unsigned int i = 0; i < substeps; i++ )
+			{
+				for( const auto & t : touches )
+				{
+					waterSimulator->disturb( t.second.point, 0.03f );
+					waterDirtyRegion->disturb( t.second.point, 0.03f );
+				}
+				lap( stage_waterModulator );
+
+				if( !waterDirtyRegion->isEmpty() )
+				{
+					if( waterDirtyRegion->step() )
+						waterSimulator->step( waterDirtyRegion->getY(), waterDirtyRegion->getY() + waterDirtyRegion->getHeight() );
+					else
+						waterSimulator->clear();
+					waterChanged = true;
+				}
+				lap( stage_water );
+
+				if( arguments.numberOfFish )
+				{
+					update_fish( fish, touchGrid );
+					lap( stage_updateFish );
+				}
+			}
+			// only the final state of this frame needs to reach the GPU
+			if( waterChanged )
+				waterTexture->upload( waterSimulator->getData() );
+			lap( stage_water );
+		}
+		else
+		{
+			// consecutive steps only differ in the framebuffer and texture they use, unless modulators are drawn in between
+			bool waterPrepared = false;
+			for( unsigned int i = 0; i < substeps; i++ )
+			{
+				// the fish do not depend on the water - the workers update them while this thread feeds the GPU
+				if( arguments.numberOfFish )
+					update_fish_start( fish, touchGrid );
+
+				if( !touches.empty() )
+				{
+					if( i == 0 )
+						upload_waterModulators( touches, 0.03f );
+					for( const auto & t : touches )
+						waterDirtyRegion->disturb( t.second.point, 0.03f );
+					waterFrameBufferSrc->bind();
+					GLState::setScissor( false );
+					render_waterModulators();
+					waterPrepared = false;
+				}
+#ifdef GLESPOND_POINTIR
+				if( cameraBlobs )
+				{
+					waterDirtyRegion->disturb( cameraBlobsPosition, cameraBlobsRadius );
+					waterFrameBufferSrc->bind();
+					GLState::setScissor( false );
+					render_waterCameraModulator( cameraTexture->getTexture() );
+					waterPrepared = false;
+				}
+#endif
+				lap( stage_waterModulator );
+
+				if( !waterDirtyRegion->isEmpty() )
+				{
+					if( waterDirtyRegion->step() )
+					{
+						// both water framebuffers have the same size, so the viewport only needs to be set once
+						waterFrameBufferDst->bind( !waterPrepared );
+						GLState::setScissor( true );
+						GLState::scissor( waterDirtyRegion->getX(), waterDirtyRegion->getY(), waterDirtyRegion->getWidth(), waterDirtyRegion->getHeight() );
+						if( !waterPrepared )
+						{
+							render_water_prepare( waterFrameBufferSrc->getWidth(), waterFrameBufferSrc->getHeight() );
+							waterPrepared = true;
+						}
+						render_water_step( waterFrameBufferSrc->getTexture() );
+						std::swap( waterFrameBufferSrc, waterFrameBufferDst );
+					}
+					else
+					{
+						// whatever is left is too small to see - make it exactly calm, so the region can start empty again
+						water_clear( waterFrameBufferSrc );
+						water_clear( waterFrameBufferDst );
+						waterPrepared = false;
+					}
+					waterChanged = true;
+				}
+				lap( stage_water );
+
+				if( arguments.numberOfFish )
+				{
+					update_fish_wait();
+					lap( stage_updateFish );
+				}
+			}
+		}
+
+		// the substeps never need the gradients, only the state that is displayed does - and it only changes with a step
+		if( waterChanged )
+		{
+			if( waterDirtyRegion->isEmpty() )
+			{
+				waterNormalFrameBuffer->clear( 0.5f, 0.5f, 0.5f, 0.5f );
+			}
+			else
+			{
+				// the gradients one pixel around the region see its heights
+				waterNormalFrameBuffer->bind();
+				GLState::setScissor( true );
+				GLState::scissor( waterDirtyRegion->getX() - 1, waterDirtyRegion->getY() - 1, waterDirtyRegion->getWidth() + 2, waterDirtyRegion->getHeight() + 2 );
+				// the source framebuffer holds the latest state after the swaps above
+				render_waterNormal( waterSimulator ? waterTexture : waterFrameBufferSrc->getTexture() );
+			}
+			lap( stage_waterNormal );
+		}
+		GLState::setScissor( false );
+
+		// the fish only move with a step
+		if( arguments.numberOfFish && substeps )
+			backgroundComposed = false;
+		if( waterChanged || ( backgroundFrameBuffer && !backgroundComposed ) )
+			redraw = true;
+
+		if( redraw )
+		{
+			// without fish the background layer is the image itself
+			const Texture2D * backgroundLayer = backgroundTexture;
+			if( backgroundFrameBuffer )
+			{
+				if( !backgroundComposed )
+				{
+					backgroundFrameBuffer->bind();
+					render_copy( backgroundTexture );
+					lap( stage_copy );
+					render_fish( fish );
+					lap( stage_fish );
+					backgroundComposed = true;
+				}
+				backgroundLayer = backgroundFrameBuffer->getTexture();
+			}
+
+			if( screenFrameBuffer )
+			{
+				screenFrameBuffer->bind();
+			}
+			else
+			{
+				GLState::bindFramebuffer( 0 );
+				GLState::viewport( 0, 0, w, h );
+			}
+			render_waterDrawer( waterNormalFrameBuffer->getTexture(), backgroundLayer );
+#ifdef GLESPOND_POINTIR
+			if( arguments.cameraView && cameraTexture->getTexture() )
+			{
+				// a quarter of the screen in the lower left corner
+				GLState::viewport( 0, 0, w / 4, h / 4 );
+				render_camera( cameraTexture->getTexture() );
+				GLState::viewport( 0, 0, w, h );
+			}
+			if( calibrationTexture )
+				render_copy( calibrationTexture );
+#endif
+			lap( stage_waterDrawer );
+
+			if( !arguments.headless )
+				SDL_GL_SwapWindow( window );
+			lap( stage_swap );
+			redraw = false;
+#ifdef GLESPOND_POINTIR
+			if( pointIR )
+				calibrate_shown();
+#endif
+		}
+		else if( !arguments.headless )
+		{
+			// nothing to show until the next step, and there is no swap to wait for - do not spin, but wake up on input
+			SDL_WaitEventTimeout( nullptr, std::max( 1, (int)( timestep.getStepSeconds() * 1000.0 ) ) );
+			lap( stage_swap );
+		}
+
+		if( firstFrame )
+		{
+			std::cout << "Startup     : " << std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - startTime ).count() << "ms to the first frame\n";
+			firstFrame = false;
+		}
+
+		timer.nextFrame();
+		if( arguments.frames && timer.getFrames() >= arguments.frames )
+			quit = true;
+	}
+
+	if( arguments.headless )
+		timer.report( std::cout );
+	if( timestep.getDroppedSteps() )
+		std::cout << "Dropped " << timestep.getDroppedSteps() << " simulation steps to keep up\n";
+	if( timer.getFrames() )
+	{
+		std::cout << "GL state    : " << (double)( GLState::getCalls() - glCallsBefore ) / timer.getFrames() << " calls per frame, "
+		          << (double)( GLState::getSavedCalls() - glSavedCallsBefore ) / timer.getFrames() << " of them skipped\n";
 	}
 
 	delete waterFrameBufferSrc;
 	delete waterFrameBufferDst;
+	delete waterNormalFrameBuffer;
+	delete waterDirtyRegion;
 	delete backgroundFrameBuffer;
+	delete screenFrameBuffer;
+	delete waterSimulator;
+	delete waterTexture;
+	delete threadPool;
+	delete imageLoader;
 	delete backgroundTexture;
 	delete fishTexture;
+	delete assetPack;
+#ifdef GLESPOND_POINTIR
+	if( cameraTexture )
+		std::cout << "Camera      : " << cameraTexture->getUploads() << " frames uploaded, " << pointIR->getDroppedFrames() << " dropped\n";
+	delete cameraTexture;
+	delete calibrationTexture;
+	delete pointIR;
+#endif
 	SDL_Quit();
 
 	return 0;
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2014 Tobias Himmer <provisorisch@online.de>
+ *
+ * This file is part of glesPond.
+ *
+ * glesPond is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * glesPond is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with glesPond.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Converts images into ETC compressed KTX files for Texture2D - opaque images become ETC1,
+// images with alpha ETC2 RGBA8 (EAC). Rows are stored bottom first, like glesPond loads them with DevIL.
+
+#include "Image.hpp"
+#include "ETC.hpp"
+
+#include <exceptions.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include <getopt.h>
+
+#include <IL/il.h>
+
+
+// expands the formats DevIL decodes to RGBA8
+static bool toRGBA( const Image & image, std::vector< uint8_t > & rgba )
+{
+	if( image.getType() != GL_UNSIGNED_BYTE )
+		return false;
+	unsigned int pixels = image.getWidth() * image.getHeight();
+	unsigned int channels = image.getSize() / pixels;
+	const uint8_t * data = image.getData();
+	rgba.resize( 4 * pixels );
+	for( unsigned int i = 0; i < pixels; i++ )
+	{
+		const uint8_t * p = data + channels * i;
+		uint8_t * q = &rgba[ 4 * i ];
+		switch( image.getFormat() )
+		{
+		case IL_RGBA:
+			q[0] = p[0]; q[1] = p[1]; q[2] = p[2]; q[3] = p[3];
+			break;
+		case IL_RGB:
+			q[0] = p[0]; q[1] = p[1]; q[2] = p[2]; q[3] = 255;
+			break;
+		case IL_BGRA:
+			q[0] = p[2]; q[1] = p[1]; q[2] = p[0]; q[3] = p[3];
+			break;
+		case IL_BGR:
+			q[0] = p[2]; q[1] = p[1]; q[2] = p[0]; q[3] = 255;
+			break;
+		case IL_LUMINANCE_ALPHA:
+			q[0] = q[1] = q[2] = p[0]; q[3] = p[1];
+			break;
+		case IL_LUMINANCE:
+			q[0] = q[1] = q[2] = p[0]; q[3] = 255;
+			break;
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static void write32( std::ofstream & stream, uint32_t value )
+{
+	stream.write( (const char *)&value, sizeof(value) );
+}
+
+
+void print_usage( int argc, char ** argv )
+{
+	printf
+	(
+		"Usage: %s [--mipmaps] [--maxSize=<width>x<height>] <input image> <output ktx file>\n",
+		argv[0]
+	);
+}
+
+
+int main( int argc, char ** argv )
+{
+	bool mipmaps = false;
+	unsigned int maxWidth = 0;
+	unsigned int maxHeight = 0;
+
+	static struct option long_options[] =
+	{
+		{ "mipmaps",                no_argument,       0, 'm' },
+		{ "maxSize",                required_argument, 0, 'M' },
+		{ 0,           0,                              0, 0   }
+	};
+
+	int opt = 0;
+	int option_index = 0;
+	while( ( opt = getopt_long( argc, argv, "mM:", long_options, &option_index ) ) != -1 )
+	{
+		switch( opt )
+		{
+		case 'm':
+			mipmaps = true;
+			break;
+		case 'M':
+			if( sscanf( optarg, "%ux%u", &maxWidth, &maxHeight ) != 2 )
+			{
+				fprintf( stderr, "Invalid size \"%s\"!\n", optarg );
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			print_usage( argc, argv );
+			return EXIT_FAILURE;
+		}
+	}
+	if( argc - optind != 2 )
+	{
+		print_usage( argc, argv );
+		return EXIT_FAILURE;
+	}
+	std::string input = argv[optind];
+	std::string output = argv[optind+1];
+
+	ilInit();
+	ilEnable( IL_ORIGIN_SET );
+	ilOriginFunc( IL_ORIGIN_LOWER_LEFT );
+
+	try
+	{
+		Image image( input );
+		if( image.isCompressed() )
+		{
+			std::cerr << "\"" << input << "\" is compressed already\n";
+			return EXIT_FAILURE;
+		}
+		image.downscale( maxWidth, maxHeight );
+
+		std::vector< uint8_t > rgba;
+		if( !toRGBA( image, rgba ) )
+		{
+			std::cerr << "Pixel format of \"" << input << "\" is not supported\n";
+			return EXIT_FAILURE;
+		}
+		bool alpha = false;
+		for( size_t i = 3; i < rgba.size() && !alpha; i += 4 )
+			alpha = rgba[i] != 255;
+		GLenum format = alpha ? GL_COMPRESSED_RGBA8_ETC2_EAC : GL_ETC1_RGB8_OES;
+
+		// GLES2 only mipmaps power of two sizes
+		unsigned int width = image.getWidth();
+		unsigned int height = image.getHeight();
+		unsigned int levels = 1;
+		if( mipmaps )
+		{
+			if( width && height && !( width & ( width - 1 ) ) && !( height & ( height - 1 ) ) )
+			{
+				while( ( std::max( width, height ) >> levels ) > 0 )
+					levels++;
+			}
+			else
+			{
+				std::cerr << "No mipmaps for " << width << "x" << height << " - the size is not a power of two\n";
+			}
+		}
+
+		std::ofstream stream( output, std::ios::binary );
+		if( !stream )
+			throw RUNTIME_ERROR( "Could not open \"" + output + "\" for writing" );
+
+		static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+		// the first row is the bottom one
+		static const char orientation[] = "KTXorientation\0S=r,T=u";
+		uint32_t orientationSize = sizeof(orientation);
+		uint32_t keyValueSize = 4 + ( ( orientationSize + 3 ) & ~3u );
+		stream.write( (const char *)identifier, sizeof(identifier) );
+		write32( stream, 0x04030201 );
+		write32( stream, 0 ); // glType
+		write32( stream, 1 ); // glTypeSize
+		write32( stream, 0 ); // glFormat
+		write32( stream, format );
+		write32( stream, alpha ? GL_RGBA : GL_RGB );
+		write32( stream, width );
+		write32( stream, height );
+		write32( stream, 0 ); // pixelDepth
+		write32( stream, 0 ); // numberOfArrayElements
+		write32( stream, 1 ); // numberOfFaces
+		write32( stream, levels );
+		write32( stream, keyValueSize );
+		write32( stream, orientationSize );
+		stream.write( orientation, sizeof(orientation) );
+		stream.write( "\0\0\0", keyValueSize - 4 - orientationSize );
+
+		size_t compressedSize = 0;
+		size_t uncompressedSize = 0;
+		for( unsigned int level = 0; level < levels; level++ )
+		{
+			if( level )
+			{
+				image.downscale( std::max( 1u, width >> level ), std::max( 1u, height >> level ) );
+				toRGBA( image, rgba );
+			}
+			std::vector< uint8_t > blocks( ETC::getSize( format, image.getWidth(), image.getHeight() ) );
+			ETC::encode( rgba.data(), image.getWidth(), image.getHeight(), alpha, blocks.data() );
+			// ETC blocks are 8 or 16 bytes, so no padding is needed
+			write32( stream, blocks.size() );
+			stream.write( (const char *)blocks.data(), blocks.size() );
+			compressedSize += blocks.size();
+			uncompressedSize += rgba.size();
+		}
+		if( !stream )
+			throw RUNTIME_ERROR( "Could not write \"" + output + "\"" );
+
+		std::cout << output << ": " << width << "x" << height << " " << ( alpha ? "ETC2 RGBA8" : "ETC1" ) << ", " << levels << " levels, "
+		          << compressedSize << " bytes instead of " << uncompressedSize << "\n";
+	}
+	catch( const std::exception & e )
+	{
+		std::cerr << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}